@@ -0,0 +1,32 @@
+## Copyright (C) Pablo Rodriguez Nava - All Rights Reserved
+##       * Unauthorized copying of this file, via any medium is strictly prohibited
+##       * Proprietary and confidential
+## Written by Pablo Rodriguez Nava <info@pablintino.com>, January 2025
+
+set(SIGNAL_CODEGEN_SCRIPT ${CMAKE_CURRENT_LIST_DIR}/../utilities/dbc_codegen.py)
+
+# Generates, at build time, the pack/unpack header (NAME_signals.h) and the host decoder (NAME_decoder.h/.c) of a DBC
+# file into OUTPUT_DIR. The generated file paths are returned in NAME_SIGNALS_HEADER and NAME_DECODER_SOURCES. Targets
+# using them must also list NAME_CODEC_STAMP in their sources so the generation runs before they are compiled
+function(generate_signal_codec DBC_FILE NAME PREFIX OUTPUT_DIR)
+    find_package(Python3 REQUIRED COMPONENTS Interpreter)
+
+    set(SIGNALS_HEADER ${OUTPUT_DIR}/${NAME}_signals.h)
+    set(DECODER_SOURCES ${OUTPUT_DIR}/${NAME}_decoder.h ${OUTPUT_DIR}/${NAME}_decoder.c)
+    set(STAMP_FILE ${OUTPUT_DIR}/${NAME}_codec.stamp)
+    # The generator leaves unchanged files untouched so their users are not rebuilt. The stamp is what tells the build
+    # that the generation is up to date with the DBC file and the script
+    add_custom_command(
+            OUTPUT ${STAMP_FILE}
+            BYPRODUCTS ${SIGNALS_HEADER} ${DECODER_SOURCES}
+            COMMAND ${Python3_EXECUTABLE} ${SIGNAL_CODEGEN_SCRIPT} ${DBC_FILE}
+            --name ${NAME} --prefix ${PREFIX} --output-dir ${OUTPUT_DIR}
+            COMMAND ${CMAKE_COMMAND} -E touch ${STAMP_FILE}
+            DEPENDS ${DBC_FILE} ${SIGNAL_CODEGEN_SCRIPT}
+            COMMENT "Generating ${NAME} signal codec from ${DBC_FILE}"
+    )
+
+    set(${NAME}_SIGNALS_HEADER ${SIGNALS_HEADER} PARENT_SCOPE)
+    set(${NAME}_DECODER_SOURCES ${DECODER_SOURCES} PARENT_SCOPE)
+    set(${NAME}_CODEC_STAMP ${STAMP_FILE} PARENT_SCOPE)
+endfunction()
@@ -0,0 +1,157 @@
+/* Copyright (C) Pablo Rodriguez Nava - All Rights Reserved
+ *       * Unauthorized copying of this file, via any medium is strictly prohibited
+ *       * Proprietary and confidential
+ * Written by Pablo Rodriguez Nava <info@pablintino.com>, January 2025
+ */
+
+/**
+ * @file isotp.h
+ * @brief ISO 15765-2 (ISO-TP) segmented transport on top of single CAN/CAN FD frames.
+ *
+ * The transport is HW agnostic: outgoing frames are handed to an ::isotp_link_t and incoming frames are fed by the
+ * caller through ::isotp_on_frame or ::isotp_dispatch_frame. Time is also given by the caller (in ticks), so the same
+ * code runs on the target and on a host with a looped-back peer. Ticks are assumed to be 1 ms long, which is the unit
+ * of the STmin parameter. Sub-millisecond STmin values are rounded up to a full tick. As the tick only tells that
+ * time has passed between two calls, not how much, consecutive frames are sent STmin + 1 ticks apart: the smallest
+ * separation that guarantees the receiver's STmin.
+ *
+ * Only normal addressing is supported. Each ::isotp_channel_t holds a full-duplex connection (one TX and one RX
+ * transfer at a time) identified by a TX and RX CAN ID pair. Any number of channels can be active concurrently.
+ *
+ * Payloads are never buffered: TX data is read directly from the caller buffer given to ::isotp_send and RX data is
+ * written directly to the buffer given to ::isotp_set_rx_buffer. Both buffers must remain valid until the transfer
+ * completes.
+ */
+#ifndef ISOTP_H
+#define ISOTP_H
+
+#include "bsp_types.h"
+#include <stdbool.h>
+
+#define ISOTP_CLASSIC_FRAME_SIZE 8U
+#define ISOTP_MAX_FRAME_SIZE 64U
+
+typedef enum isotp_result_e {
+    ISOTP_RESULT_OK = 0x00U,
+    /* N_Bs (waiting for a flow control) or N_Cr (waiting for a consecutive frame) expired */
+    ISOTP_RESULT_TIMEOUT = 0x01U,
+    /* Unexpected sequence number in a consecutive frame */
+    ISOTP_RESULT_WRONG_SN = 0x02U,
+    /* The receiver has no room for the message */
+    ISOTP_RESULT_OVERFLOW = 0x03U,
+    /* A new transfer from the peer interrupted an ongoing reception */
+    ISOTP_RESULT_UNEXPECTED_PDU = 0x04U,
+    /* Invalid flow status received */
+    ISOTP_RESULT_INVALID_FS = 0x05U,
+    /* Transfer cancelled by ::isotp_abort */
+    ISOTP_RESULT_ABORTED = 0x06U
+} isotp_result_t;
+
+typedef enum isotp_tx_state_e {
+    ISOTP_TX_STATE_IDLE = 0x00U,
+    ISOTP_TX_STATE_SEND_FIRST = 0x01U,
+    ISOTP_TX_STATE_WAIT_FC = 0x02U,
+    ISOTP_TX_STATE_SEND_CF = 0x03U
+} isotp_tx_state_t;
+
+typedef enum isotp_rx_state_e {
+    ISOTP_RX_STATE_IDLE = 0x00U,
+    ISOTP_RX_STATE_RECEIVING = 0x01U
+} isotp_rx_state_t;
+
+struct isotp_channel_s;
+
+/**
+ * Link used to send single frames.
+ *
+ * isotp_link_t::send_frame must not block. It returns ::STATUS_OK if the frame has been queued for transmission or
+ * any other value if it cannot be queued right now, in which case the transport retries in the next poll.
+ * The size is always a valid CAN/CAN FD payload length (0-8, 12, 16, 20, 24, 32, 48 or 64).
+ */
+typedef struct isotp_link_t {
+    ret_status (*send_frame)(void *context, uint32_t id, bool extended_id, const uint8_t *data, uint8_t size);
+    void *context;
+} isotp_link_t;
+
+typedef void (*isotp_tx_handler_t)(struct isotp_channel_s *channel, isotp_result_t result);
+
+typedef void (*isotp_rx_handler_t)(struct isotp_channel_s *channel,
+                                   isotp_result_t result,
+                                   uint8_t *data,
+                                   uint32_t size);
+
+typedef struct isotp_channel_config_t {
+    uint32_t tx_id;
+    uint32_t rx_id;
+    bool extended_id;
+    /**
+     * Maximum frame payload used when transmitting. ::ISOTP_CLASSIC_FRAME_SIZE for classic CAN, up to
+     * ::ISOTP_MAX_FRAME_SIZE for CAN FD links.
+     */
+    uint8_t frame_size;
+    /**
+     * Block size advertised in our flow controls. Zero means no more flow controls during the transfer.
+     */
+    uint8_t block_size;
+    /**
+     * STmin advertised in our flow controls, raw ISO 15765-2 encoding (0x00-0x7F ms, 0xF1-0xF9 100-900 us).
+     */
+    uint8_t st_min;
+    /**
+     * Timeout, in ticks, for the N_Bs and N_Cr timers.
+     */
+    uint32_t timeout;
+    /**
+     * Byte used to fill unused bytes of the frames.
+     */
+    uint8_t padding;
+    isotp_tx_handler_t tx_handler;
+    isotp_rx_handler_t rx_handler;
+} isotp_channel_config_t;
+
+typedef struct isotp_channel_s {
+    isotp_channel_config_t config;
+    const isotp_link_t *link;
+    void *user_data;
+
+    isotp_tx_state_t tx_state;
+    const uint8_t *tx_data;
+    uint32_t tx_size;
+    uint32_t tx_offset;
+    uint8_t tx_sn;
+    uint8_t tx_block_size;
+    uint8_t tx_block_count;
+    uint32_t tx_st_min;
+    uint32_t tx_tick;
+
+    isotp_rx_state_t rx_state;
+    uint8_t *rx_buffer;
+    uint32_t rx_capacity;
+    uint32_t rx_size;
+    uint32_t rx_offset;
+    uint8_t rx_sn;
+    uint8_t rx_block_count;
+    uint32_t rx_tick;
+    bool rx_fc_pending;
+} isotp_channel_t;
+
+ret_status isotp_init(isotp_channel_t *channel, const isotp_channel_config_t *config, const isotp_link_t *link);
+
+ret_status isotp_set_rx_buffer(isotp_channel_t *channel, uint8_t *buffer, uint32_t capacity);
+
+ret_status isotp_send(isotp_channel_t *channel, const uint8_t *data, uint32_t size, uint32_t now);
+
+ret_status isotp_on_frame(isotp_channel_t *channel, const uint8_t *data, uint8_t size, uint32_t now);
+
+ret_status isotp_dispatch_frame(
+    isotp_channel_t *channels, uint8_t count, uint32_t id, const uint8_t *data, uint8_t size, uint32_t now);
+
+void isotp_poll(isotp_channel_t *channel, uint32_t now);
+
+void isotp_abort(isotp_channel_t *channel);
+
+bool isotp_is_busy(const isotp_channel_t *channel);
+
+uint8_t isotp_round_frame_size(uint8_t size);
+
+#endif // ISOTP_H
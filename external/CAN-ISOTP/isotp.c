@@ -0,0 +1,500 @@
+/* Copyright (C) Pablo Rodriguez Nava - All Rights Reserved
+ *       * Unauthorized copying of this file, via any medium is strictly prohibited
+ *       * Proprietary and confidential
+ * Written by Pablo Rodriguez Nava <info@pablintino.com>, January 2025
+ */
+
+#include "isotp.h"
+
+#include <string.h>
+
+#define __ISOTP_PCI_TYPE_MASK 0xF0U
+#define __ISOTP_PCI_TYPE_SF 0x00U
+#define __ISOTP_PCI_TYPE_FF 0x10U
+#define __ISOTP_PCI_TYPE_CF 0x20U
+#define __ISOTP_PCI_TYPE_FC 0x30U
+
+#define __ISOTP_FS_CTS 0x00U
+#define __ISOTP_FS_WAIT 0x01U
+#define __ISOTP_FS_OVFLW 0x02U
+
+/* Biggest length that fits in the 12 bits FF_DL field. Bigger messages use the 32 bits escape sequence */
+#define __ISOTP_FF_DL_12_BITS_MAX 0x0FFFU
+
+static const uint8_t __ISOTP_VALID_FRAME_SIZES[] = {0, 1, 2, 3, 4, 5, 6, 7, 8, 12, 16, 20, 24, 32, 48, 64};
+
+static void __isotp_tx_complete(isotp_channel_t *channel, isotp_result_t result);
+
+static void __isotp_rx_complete(isotp_channel_t *channel, isotp_result_t result);
+
+static ret_status __isotp_send_padded(isotp_channel_t *channel, uint8_t *frame, uint8_t used);
+
+static ret_status __isotp_send_first_frame(isotp_channel_t *channel, uint32_t now);
+
+static void __isotp_send_consecutive_frames(isotp_channel_t *channel, uint32_t now);
+
+static ret_status __isotp_send_flow_control(isotp_channel_t *channel, uint8_t flow_status);
+
+static void __isotp_process_flow_control(isotp_channel_t *channel, const uint8_t *data, uint8_t size, uint32_t now);
+
+static void __isotp_process_single_frame(isotp_channel_t *channel, const uint8_t *data, uint8_t size);
+
+static void __isotp_process_first_frame(isotp_channel_t *channel, const uint8_t *data, uint8_t size, uint32_t now);
+
+static void __isotp_process_consecutive_frame(isotp_channel_t *channel,
+                                              const uint8_t *data,
+                                              uint8_t size,
+                                              uint32_t now);
+
+static inline uint32_t __isotp_decode_st_min(uint8_t st_min);
+
+ret_status isotp_init(isotp_channel_t *channel, const isotp_channel_config_t *config, const isotp_link_t *link)
+{
+    if (channel == NULL || config == NULL || link == NULL || link->send_frame == NULL) {
+        return STATUS_ERR;
+    }
+
+    /* Frame size must be a valid CAN/CAN FD length able to hold, at least, a classic frame */
+    if (config->frame_size < ISOTP_CLASSIC_FRAME_SIZE || config->frame_size > ISOTP_MAX_FRAME_SIZE ||
+        isotp_round_frame_size(config->frame_size) != config->frame_size) {
+        return STATUS_ERR;
+    }
+
+    memset(channel, 0, sizeof(isotp_channel_t));
+    channel->config = *config;
+    channel->link = link;
+    channel->tx_state = ISOTP_TX_STATE_IDLE;
+    channel->rx_state = ISOTP_RX_STATE_IDLE;
+
+    return STATUS_OK;
+}
+
+ret_status isotp_set_rx_buffer(isotp_channel_t *channel, uint8_t *buffer, uint32_t capacity)
+{
+    if (channel == NULL || (buffer == NULL && capacity != 0)) {
+        return STATUS_ERR;
+    }
+
+    /* Cannot swap the buffer in the middle of a reception */
+    if (channel->rx_state != ISOTP_RX_STATE_IDLE) {
+        return STATUS_ERR;
+    }
+
+    channel->rx_buffer = buffer;
+    channel->rx_capacity = capacity;
+    return STATUS_OK;
+}
+
+ret_status isotp_send(isotp_channel_t *channel, const uint8_t *data, uint32_t size, uint32_t now)
+{
+    if (channel == NULL || data == NULL || size == 0) {
+        return STATUS_ERR;
+    }
+
+    if (channel->tx_state != ISOTP_TX_STATE_IDLE) {
+        return STATUS_ERR;
+    }
+
+    channel->tx_data = data;
+    channel->tx_size = size;
+    channel->tx_offset = 0;
+    channel->tx_sn = 0;
+    channel->tx_tick = now;
+    channel->tx_state = ISOTP_TX_STATE_SEND_FIRST;
+
+    /* Try to send the first frame right now. If the link is busy it will be retried in the next poll */
+    isotp_poll(channel, now);
+    return STATUS_OK;
+}
+
+ret_status isotp_on_frame(isotp_channel_t *channel, const uint8_t *data, uint8_t size, uint32_t now)
+{
+    if (channel == NULL || data == NULL || size == 0) {
+        return STATUS_ERR;
+    }
+
+    switch (data[0] & __ISOTP_PCI_TYPE_MASK) {
+    case __ISOTP_PCI_TYPE_SF:
+        __isotp_process_single_frame(channel, data, size);
+        break;
+    case __ISOTP_PCI_TYPE_FF:
+        __isotp_process_first_frame(channel, data, size, now);
+        break;
+    case __ISOTP_PCI_TYPE_CF:
+        __isotp_process_consecutive_frame(channel, data, size, now);
+        break;
+    case __ISOTP_PCI_TYPE_FC:
+        __isotp_process_flow_control(channel, data, size, now);
+        break;
+    default:
+        /* Unknown PCI types are silently ignored as required by the standard */
+        break;
+    }
+
+    return STATUS_OK;
+}
+
+ret_status isotp_dispatch_frame(
+    isotp_channel_t *channels, uint8_t count, uint32_t id, const uint8_t *data, uint8_t size, uint32_t now)
+{
+    if (channels == NULL) {
+        return STATUS_ERR;
+    }
+
+    for (uint8_t index = 0; index < count; index++) {
+        if (channels[index].config.rx_id == id) {
+            return isotp_on_frame(&channels[index], data, size, now);
+        }
+    }
+
+    /* Not an ISO-TP frame for any of the given channels */
+    return STATUS_ERR;
+}
+
+void isotp_poll(isotp_channel_t *channel, uint32_t now)
+{
+    if (channel == NULL) {
+        return;
+    }
+
+    switch (channel->tx_state) {
+    case ISOTP_TX_STATE_SEND_FIRST:
+        if (__isotp_send_first_frame(channel, now) != STATUS_OK &&
+            (now - channel->tx_tick) >= channel->config.timeout) {
+            /* N_As: the link has been unable to send the frame */
+            __isotp_tx_complete(channel, ISOTP_RESULT_TIMEOUT);
+        }
+        break;
+    case ISOTP_TX_STATE_WAIT_FC:
+        if ((now - channel->tx_tick) >= channel->config.timeout) {
+            __isotp_tx_complete(channel, ISOTP_RESULT_TIMEOUT);
+        }
+        break;
+    case ISOTP_TX_STATE_SEND_CF:
+        __isotp_send_consecutive_frames(channel, now);
+        break;
+    default:
+        break;
+    }
+
+    if (channel->rx_state == ISOTP_RX_STATE_RECEIVING) {
+        if (channel->rx_fc_pending && __isotp_send_flow_control(channel, __ISOTP_FS_CTS) == STATUS_OK) {
+            channel->rx_fc_pending = false;
+            channel->rx_tick = now;
+        }
+        if ((now - channel->rx_tick) >= channel->config.timeout) {
+            __isotp_rx_complete(channel, ISOTP_RESULT_TIMEOUT);
+        }
+    }
+}
+
+void isotp_abort(isotp_channel_t *channel)
+{
+    if (channel == NULL) {
+        return;
+    }
+
+    if (channel->tx_state != ISOTP_TX_STATE_IDLE) {
+        __isotp_tx_complete(channel, ISOTP_RESULT_ABORTED);
+    }
+    if (channel->rx_state != ISOTP_RX_STATE_IDLE) {
+        __isotp_rx_complete(channel, ISOTP_RESULT_ABORTED);
+    }
+}
+
+bool isotp_is_busy(const isotp_channel_t *channel)
+{
+    return channel->tx_state != ISOTP_TX_STATE_IDLE || channel->rx_state != ISOTP_RX_STATE_IDLE;
+}
+
+uint8_t isotp_round_frame_size(uint8_t size)
+{
+    for (uint8_t index = 0; index < sizeof(__ISOTP_VALID_FRAME_SIZES); index++) {
+        if (__ISOTP_VALID_FRAME_SIZES[index] >= size) {
+            return __ISOTP_VALID_FRAME_SIZES[index];
+        }
+    }
+    return ISOTP_MAX_FRAME_SIZE;
+}
+
+static void __isotp_tx_complete(isotp_channel_t *channel, isotp_result_t result)
+{
+    channel->tx_state = ISOTP_TX_STATE_IDLE;
+    channel->tx_data = NULL;
+    if (channel->config.tx_handler != NULL) {
+        channel->config.tx_handler(channel, result);
+    }
+}
+
+static void __isotp_rx_complete(isotp_channel_t *channel, isotp_result_t result)
+{
+    channel->rx_state = ISOTP_RX_STATE_IDLE;
+    channel->rx_fc_pending = false;
+    if (channel->config.rx_handler != NULL) {
+        channel->config.rx_handler(channel, result, channel->rx_buffer, channel->rx_offset);
+    }
+}
+
+static ret_status __isotp_send_padded(isotp_channel_t *channel, uint8_t *frame, uint8_t used)
+{
+    /* Frames are never shorter than a classic frame. FD frames are padded up to the next valid length */
+    const uint8_t frame_size = isotp_round_frame_size(used < ISOTP_CLASSIC_FRAME_SIZE ? ISOTP_CLASSIC_FRAME_SIZE
+                                                                                       : used);
+    memset(&frame[used], channel->config.padding, frame_size - used);
+
+    return channel->link->send_frame(
+        channel->link->context, channel->config.tx_id, channel->config.extended_id, frame, frame_size);
+}
+
+static ret_status __isotp_send_first_frame(isotp_channel_t *channel, uint32_t now)
+{
+    uint8_t frame[ISOTP_MAX_FRAME_SIZE];
+    const uint8_t frame_size = channel->config.frame_size;
+    const uint32_t size = channel->tx_size;
+
+    /* Single frame: classic format up to 7 bytes, FD escape sequence (SF_DL in the second byte) above that */
+    if (size < ISOTP_CLASSIC_FRAME_SIZE || (frame_size > ISOTP_CLASSIC_FRAME_SIZE && size <= frame_size - 2U)) {
+        uint8_t header_size;
+        if (size < ISOTP_CLASSIC_FRAME_SIZE) {
+            frame[0] = __ISOTP_PCI_TYPE_SF | (uint8_t)size;
+            header_size = 1U;
+        } else {
+            frame[0] = __ISOTP_PCI_TYPE_SF;
+            frame[1] = (uint8_t)size;
+            header_size = 2U;
+        }
+        memcpy(&frame[header_size], channel->tx_data, size);
+
+        const ret_status status = __isotp_send_padded(channel, frame, header_size + (uint8_t)size);
+        if (status == STATUS_OK) {
+            __isotp_tx_complete(channel, ISOTP_RESULT_OK);
+        }
+        return status;
+    }
+
+    /* First frame: 12 bits FF_DL if possible, 32 bits escape sequence otherwise */
+    uint8_t header_size;
+    if (size <= __ISOTP_FF_DL_12_BITS_MAX) {
+        frame[0] = __ISOTP_PCI_TYPE_FF | (uint8_t)(size >> 8U);
+        frame[1] = (uint8_t)size;
+        header_size = 2U;
+    } else {
+        frame[0] = __ISOTP_PCI_TYPE_FF;
+        frame[1] = 0x00U;
+        frame[2] = (uint8_t)(size >> 24U);
+        frame[3] = (uint8_t)(size >> 16U);
+        frame[4] = (uint8_t)(size >> 8U);
+        frame[5] = (uint8_t)size;
+        header_size = 6U;
+    }
+
+    /* First frames always use the full frame size */
+    const uint8_t chunk = frame_size - header_size;
+    memcpy(&frame[header_size], channel->tx_data, chunk);
+
+    const ret_status status = channel->link->send_frame(
+        channel->link->context, channel->config.tx_id, channel->config.extended_id, frame, frame_size);
+    if (status == STATUS_OK) {
+        channel->tx_offset = chunk;
+        channel->tx_sn = 1U;
+        channel->tx_tick = now;
+        channel->tx_state = ISOTP_TX_STATE_WAIT_FC;
+    }
+    return status;
+}
+
+static void __isotp_send_consecutive_frames(isotp_channel_t *channel, uint32_t now)
+{
+    uint8_t frame[ISOTP_MAX_FRAME_SIZE];
+
+    /* With STmin zero send as many frames as the link accepts. Otherwise one frame per STmin period. Two frames sent
+     * N ticks apart may be only N - 1 ticks away in real time, so STmin + 1 ticks are waited */
+    while (channel->tx_state == ISOTP_TX_STATE_SEND_CF) {
+        if (channel->tx_st_min != 0 && (now - channel->tx_tick) <= channel->tx_st_min) {
+            return;
+        }
+
+        const uint32_t remaining = channel->tx_size - channel->tx_offset;
+        const uint8_t max_chunk = channel->config.frame_size - 1U;
+        const uint8_t chunk = remaining < max_chunk ? (uint8_t)remaining : max_chunk;
+
+        frame[0] = __ISOTP_PCI_TYPE_CF | (channel->tx_sn & 0x0FU);
+        memcpy(&frame[1], &channel->tx_data[channel->tx_offset], chunk);
+        if (__isotp_send_padded(channel, frame, chunk + 1U) != STATUS_OK) {
+            /* Link busy, retry in the next poll */
+            return;
+        }
+
+        channel->tx_offset += chunk;
+        channel->tx_sn = (channel->tx_sn + 1U) & 0x0FU;
+        channel->tx_tick = now;
+
+        if (channel->tx_offset >= channel->tx_size) {
+            __isotp_tx_complete(channel, ISOTP_RESULT_OK);
+        } else if (channel->tx_block_size != 0 && ++channel->tx_block_count >= channel->tx_block_size) {
+            /* End of the block, the receiver must send a new flow control */
+            channel->tx_state = ISOTP_TX_STATE_WAIT_FC;
+        }
+    }
+}
+
+static ret_status __isotp_send_flow_control(isotp_channel_t *channel, uint8_t flow_status)
+{
+    uint8_t frame[ISOTP_MAX_FRAME_SIZE];
+    frame[0] = __ISOTP_PCI_TYPE_FC | flow_status;
+    frame[1] = channel->config.block_size;
+    frame[2] = channel->config.st_min;
+    return __isotp_send_padded(channel, frame, 3U);
+}
+
+static void __isotp_process_flow_control(isotp_channel_t *channel, const uint8_t *data, uint8_t size, uint32_t now)
+{
+    /* Flow controls are only meaningful while waiting for one */
+    if (channel->tx_state != ISOTP_TX_STATE_WAIT_FC || size < 3U) {
+        return;
+    }
+
+    switch (data[0] & 0x0FU) {
+    case __ISOTP_FS_CTS:
+        channel->tx_block_size = data[1];
+        channel->tx_block_count = 0;
+        channel->tx_st_min = __isotp_decode_st_min(data[2]);
+        channel->tx_state = ISOTP_TX_STATE_SEND_CF;
+        /* Force the first CF of the block to go out right now */
+        channel->tx_tick = now - channel->tx_st_min - 1U;
+        __isotp_send_consecutive_frames(channel, now);
+        break;
+    case __ISOTP_FS_WAIT:
+        /* Receiver asks for more time. Restart N_Bs */
+        channel->tx_tick = now;
+        break;
+    case __ISOTP_FS_OVFLW:
+        __isotp_tx_complete(channel, ISOTP_RESULT_OVERFLOW);
+        break;
+    default:
+        __isotp_tx_complete(channel, ISOTP_RESULT_INVALID_FS);
+        break;
+    }
+}
+
+static void __isotp_process_single_frame(isotp_channel_t *channel, const uint8_t *data, uint8_t size)
+{
+    uint32_t length = data[0] & 0x0FU;
+    uint8_t header_size = 1U;
+
+    /* SF_DL zero is the escape sequence for FD single frames. Real length is in the second byte */
+    if (length == 0) {
+        if (size <= ISOTP_CLASSIC_FRAME_SIZE) {
+            return;
+        }
+        length = data[1];
+        header_size = 2U;
+    }
+
+    if (length == 0 || length > (uint32_t)(size - header_size)) {
+        return;
+    }
+
+    /* A new message from the peer interrupts any ongoing reception */
+    if (channel->rx_state == ISOTP_RX_STATE_RECEIVING) {
+        __isotp_rx_complete(channel, ISOTP_RESULT_UNEXPECTED_PDU);
+    }
+
+    if (length > channel->rx_capacity) {
+        channel->rx_offset = 0;
+        __isotp_rx_complete(channel, ISOTP_RESULT_OVERFLOW);
+        return;
+    }
+
+    memcpy(channel->rx_buffer, &data[header_size], length);
+    channel->rx_size = length;
+    channel->rx_offset = length;
+    __isotp_rx_complete(channel, ISOTP_RESULT_OK);
+}
+
+static void __isotp_process_first_frame(isotp_channel_t *channel, const uint8_t *data, uint8_t size, uint32_t now)
+{
+    if (size < ISOTP_CLASSIC_FRAME_SIZE) {
+        return;
+    }
+
+    uint32_t length = ((uint32_t)(data[0] & 0x0FU) << 8U) | data[1];
+    uint8_t header_size = 2U;
+    if (length == 0) {
+        length = ((uint32_t)data[2] << 24U) | ((uint32_t)data[3] << 16U) | ((uint32_t)data[4] << 8U) | data[5];
+        header_size = 6U;
+    }
+
+    /* Messages that fit in the first frame should have been sent as single frames */
+    if (length <= (uint32_t)(size - header_size)) {
+        return;
+    }
+
+    if (channel->rx_state == ISOTP_RX_STATE_RECEIVING) {
+        __isotp_rx_complete(channel, ISOTP_RESULT_UNEXPECTED_PDU);
+    }
+
+    if (length > channel->rx_capacity) {
+        /* Tell the sender we cannot handle it. Nothing to do if the link is busy, sender will time out */
+        __isotp_send_flow_control(channel, __ISOTP_FS_OVFLW);
+        channel->rx_offset = 0;
+        __isotp_rx_complete(channel, ISOTP_RESULT_OVERFLOW);
+        return;
+    }
+
+    const uint8_t chunk = size - header_size;
+    memcpy(channel->rx_buffer, &data[header_size], chunk);
+    channel->rx_size = length;
+    channel->rx_offset = chunk;
+    channel->rx_sn = 1U;
+    channel->rx_block_count = 0;
+    channel->rx_tick = now;
+    channel->rx_state = ISOTP_RX_STATE_RECEIVING;
+    channel->rx_fc_pending = __isotp_send_flow_control(channel, __ISOTP_FS_CTS) != STATUS_OK;
+}
+
+static void __isotp_process_consecutive_frame(isotp_channel_t *channel,
+                                              const uint8_t *data,
+                                              uint8_t size,
+                                              uint32_t now)
+{
+    if (channel->rx_state != ISOTP_RX_STATE_RECEIVING) {
+        return;
+    }
+
+    if ((data[0] & 0x0FU) != channel->rx_sn) {
+        __isotp_rx_complete(channel, ISOTP_RESULT_WRONG_SN);
+        return;
+    }
+
+    const uint32_t remaining = channel->rx_size - channel->rx_offset;
+    const uint32_t chunk = remaining < (uint32_t)(size - 1U) ? remaining : (uint32_t)(size - 1U);
+    memcpy(&channel->rx_buffer[channel->rx_offset], &data[1], chunk);
+    channel->rx_offset += chunk;
+    channel->rx_sn = (channel->rx_sn + 1U) & 0x0FU;
+    channel->rx_tick = now;
+
+    if (channel->rx_offset >= channel->rx_size) {
+        __isotp_rx_complete(channel, ISOTP_RESULT_OK);
+        return;
+    }
+
+    /* End of the block we have advertised. Let the sender continue */
+    if (channel->config.block_size != 0 && ++channel->rx_block_count >= channel->config.block_size) {
+        channel->rx_block_count = 0;
+        channel->rx_fc_pending = __isotp_send_flow_control(channel, __ISOTP_FS_CTS) != STATUS_OK;
+    }
+}
+
+static inline uint32_t __isotp_decode_st_min(uint8_t st_min)
+{
+    /* 0x00-0x7F: milliseconds. 0xF1-0xF9: 100-900 us, rounded up to a full tick. Reserved values are handled as the
+     * maximum STmin as required by the standard */
+    if (st_min <= 0x7FU) {
+        return st_min;
+    }
+    if (st_min >= 0xF1U && st_min <= 0xF9U) {
+        return 1U;
+    }
+    return 0x7FU;
+}
@@ -32,6 +32,14 @@ static void __badc_config_channel_sampling_time(badc_instance_t *adc,
 
 static void __badc_irq_handler(badc_instance_t *adc);
 
+static inline uint32_t
+__badc_get_awd_threshold(const badc_instance_t *adc, badc_awd_t awd, uint16_t threshold, bool high_threshold);
+
+static inline ret_status __badc_write_awd_thresholds(badc_instance_t *adc,
+                                                     badc_awd_t awd,
+                                                     uint16_t low_threshold,
+                                                     uint16_t high_threshold);
+
 static inline struct __badc_irqs_state_s *__badc_get_instance_state(badc_instance_t *adc);
 
 #if defined(ADC5)
@@ -49,13 +57,11 @@ static struct __badc_irqs_state_s __badc_internal_states[1U];
 #if defined(ADC1) || defined(ADC2)
 static void __irq_handler_adc12(void)
 {
-    /* ADC1 and ADC2 share the same IRQ line. Should check here the source */
-    if (__BSP_IS_FLAG_SET(ADC1->ISR, ADC_ISR_EOC) || __BSP_IS_FLAG_SET(ADC1->ISR, ADC_ISR_EOS) ||
-        __BSP_IS_FLAG_SET(ADC1->ISR, ADC_ISR_OVR)) {
+    /* ADC1 and ADC2 share the same IRQ line. Should check here the source: any enabled and flagged IRQ source */
+    if ((ADC1->ISR & ADC1->IER) != 0) {
         __badc_irq_handler(ADC1);
     }
-    if (__BSP_IS_FLAG_SET(ADC2->ISR, ADC_ISR_EOC) || __BSP_IS_FLAG_SET(ADC2->ISR, ADC_ISR_EOS) ||
-        __BSP_IS_FLAG_SET(ADC2->ISR, ADC_ISR_OVR)) {
+    if ((ADC2->ISR & ADC2->IER) != 0) {
         __badc_irq_handler(ADC2);
     }
 }
@@ -235,6 +241,58 @@ ret_status badc_calibrate(badc_instance_t *adc, bool differential)
     return butil_wait_flag_status_now(&adc->CR, ADC_CR_ADCAL, 0U, 1000U);
 }
 
+ret_status badc_get_calibration(badc_instance_t *adc, badc_calibration_t *calibration)
+{
+    if (adc == NULL || calibration == NULL) {
+        return STATUS_ERR;
+    }
+
+    const uint32_t calfact = adc->CALFACT;
+    calibration->single_ended = (calfact & ADC_CALFACT_CALFACT_S) >> ADC_CALFACT_CALFACT_S_Pos;
+    calibration->differential = (calfact & ADC_CALFACT_CALFACT_D) >> ADC_CALFACT_CALFACT_D_Pos;
+    return STATUS_OK;
+}
+
+ret_status badc_set_calibration(badc_instance_t *adc, const badc_calibration_t *calibration)
+{
+    if (adc == NULL || calibration == NULL) {
+        return STATUS_ERR;
+    }
+
+    /* CALFACT can only be written with the ADC enabled and no ongoing conversions */
+    if ((adc->CR & (ADC_CR_JADSTART | ADC_CR_ADSTART | ADC_CR_ADEN)) != ADC_CR_ADEN) {
+        return STATUS_ERR;
+    }
+
+    __BSP_SET_REG_VALUE(
+        adc->CALFACT,
+        ((calibration->single_ended << ADC_CALFACT_CALFACT_S_Pos) & ADC_CALFACT_CALFACT_S) |
+            ((calibration->differential << ADC_CALFACT_CALFACT_D_Pos) & ADC_CALFACT_CALFACT_D));
+    return STATUS_OK;
+}
+
+ret_status badc_config_internal_channels(badc_instance_t *adc, bool vrefint, bool temperature_sensor)
+{
+    ADC_Common_TypeDef *common = NULL;
+    if (adc == ADC1 || adc == ADC2) {
+        common = ADC12_COMMON;
+    }
+#if defined(ADC3) || defined(ADC4) || defined(ADC5)
+    else {
+        common = ADC345_COMMON;
+    }
+#endif
+
+    if (common == NULL) {
+        return STATUS_ERR;
+    }
+
+    __BSP_SET_MASKED_REG_VALUE(common->CCR,
+                               ADC_CCR_VREFEN | ADC_CCR_VSENSESEL,
+                               (vrefint ? ADC_CCR_VREFEN : 0U) | (temperature_sensor ? ADC_CCR_VSENSESEL : 0U));
+    return STATUS_OK;
+}
+
 ret_status badc_config_clk_source(badc_instance_t *adc, badc_clock_source_t clock_source)
 {
     if (adc == ADC1 || adc == ADC2) {
@@ -264,6 +322,21 @@ ret_status badc_start_conversion(badc_instance_t *adc)
     return STATUS_OK;
 }
 
+ret_status badc_stop_conversion(badc_instance_t *adc)
+{
+    if (!__BSP_IS_FLAG_SET(adc->CR, ADC_CR_ADSTART)) {
+        /* Nothing to stop */
+        return STATUS_OK;
+    }
+
+    if (!__BSP_IS_FLAG_SET(adc->CR, ADC_CR_ADDIS)) {
+        __BSP_SET_MASKED_REG(adc->CR, ADC_CR_ADSTP);
+    }
+
+    /* ADSTART is cleared by HW once the ongoing conversion is aborted */
+    return butil_wait_flag_status_now(&adc->CR, ADC_CR_ADSTART, 0U, 25u);
+}
+
 ret_status badc_wait_conversion(badc_instance_t *adc, uint32_t timeout)
 {
     /* If ADC not enabled just return error */
@@ -369,6 +442,91 @@ ret_status badc_config_irq(badc_instance_t *adc, badc_isr_type_t irq, badc_isr_h
     return STATUS_ERR;
 }
 
+ret_status badc_disable_irq(badc_instance_t *adc, badc_isr_type_t irq)
+{
+    if (irq > ADC_ISR_JQOVF_Pos || adc == NULL) {
+        return STATUS_ERR;
+    }
+
+    /* Just mask the source. The registered handler is kept so the IRQ can be unmasked again with badc_config_irq */
+    __BSP_CLEAR_MASKED_REG(adc->IER, (1U << irq));
+    return STATUS_OK;
+}
+
+ret_status badc_config_awd(badc_instance_t *adc, badc_awd_t awd, const badc_awd_config_t *config)
+{
+    if (adc == NULL || config == NULL || config->channels == 0 || config->low_threshold > config->high_threshold) {
+        return STATUS_ERR;
+    }
+
+    /* Channel selection can only be changed when no conversion is ongoing */
+    if ((adc->CR & (ADC_CR_JADSTART | ADC_CR_ADSTART)) != 0) {
+        return STATUS_ERR;
+    }
+
+    if (awd == BADC_AWD_1) {
+        const bool all_channels = config->channels == BADC_AWD_ALL_CHANNELS;
+        /* AWD1 can only watch a single channel or all of them */
+        if (!all_channels && (config->channels & (config->channels - 1U)) != 0) {
+            return STATUS_ERR;
+        }
+        if (config->filtering > (ADC_TR1_AWDFILT >> ADC_TR1_AWDFILT_Pos)) {
+            return STATUS_ERR;
+        }
+
+        const uint32_t cfgr_value = ADC_CFGR_AWD1EN |
+                                    (all_channels ? 0x00U
+                                                  : (ADC_CFGR_AWD1SGL | ((uint32_t)__builtin_ctz(config->channels)
+                                                                         << ADC_CFGR_AWD1CH_Pos)));
+        __BSP_SET_MASKED_REG_VALUE(adc->CFGR, ADC_CFGR_AWD1EN | ADC_CFGR_AWD1SGL | ADC_CFGR_AWD1CH, cfgr_value);
+        __BSP_SET_MASKED_REG_VALUE(adc->TR1, ADC_TR1_AWDFILT, (uint32_t)config->filtering << ADC_TR1_AWDFILT_Pos);
+    } else if (awd == BADC_AWD_2) {
+        __BSP_SET_REG_VALUE(adc->AWD2CR, config->channels & ADC_AWD2CR_AWD2CH);
+    } else if (awd == BADC_AWD_3) {
+        __BSP_SET_REG_VALUE(adc->AWD3CR, config->channels & ADC_AWD3CR_AWD3CH);
+    } else {
+        return STATUS_ERR;
+    }
+
+    return __badc_write_awd_thresholds(adc, awd, config->low_threshold, config->high_threshold);
+}
+
+ret_status badc_set_awd_thresholds(badc_instance_t *adc,
+                                   badc_awd_t awd,
+                                   uint16_t low_threshold,
+                                   uint16_t high_threshold)
+{
+    if (adc == NULL || low_threshold > high_threshold) {
+        return STATUS_ERR;
+    }
+
+    /* Unlike the channel selection, thresholds can be updated while conversions are ongoing */
+    return __badc_write_awd_thresholds(adc, awd, low_threshold, high_threshold);
+}
+
+ret_status badc_disable_awd(badc_instance_t *adc, badc_awd_t awd)
+{
+    if (adc == NULL) {
+        return STATUS_ERR;
+    }
+
+    if ((adc->CR & (ADC_CR_JADSTART | ADC_CR_ADSTART)) != 0) {
+        return STATUS_ERR;
+    }
+
+    if (awd == BADC_AWD_1) {
+        __BSP_CLEAR_MASKED_REG(adc->CFGR, ADC_CFGR_AWD1EN | ADC_CFGR_JAWD1EN);
+    } else if (awd == BADC_AWD_2) {
+        __BSP_SET_REG_VALUE(adc->AWD2CR, 0x00U);
+    } else if (awd == BADC_AWD_3) {
+        __BSP_SET_REG_VALUE(adc->AWD3CR, 0x00U);
+    } else {
+        return STATUS_ERR;
+    }
+
+    return STATUS_OK;
+}
+
 ret_status badc_start_conversion_dma(
     badc_instance_t *adc, bdma_instance_t *dma, bdma_chan_t channel, uint8_t *data_address, uint16_t data_count)
 {
@@ -468,6 +626,69 @@ static inline ret_status __badc_get_sequencer_position(badc_instance_t *adc,
     return STATUS_OK;
 }
 
+static inline uint32_t
+__badc_get_awd_threshold(const badc_instance_t *adc, badc_awd_t awd, uint16_t threshold, bool high_threshold)
+{
+    /* RES field: 0 -> 12 bits, 1 -> 10 bits, 2 -> 8 bits, 3 -> 6 bits */
+    const uint8_t resolution = (adc->CFGR & ADC_CFGR_RES) >> ADC_CFGR_RES_Pos;
+
+    /* Saturate to the full scale of the current resolution to avoid wrapping windows computed by the caller */
+    const uint16_t full_scale = 0x0FFFU >> (resolution * 2U);
+    if (threshold > full_scale) {
+        threshold = full_scale;
+    }
+
+    if (awd == BADC_AWD_1) {
+        /* AWD1 compares against the 12 bits left padded conversion */
+        return ((uint32_t)threshold << (resolution * 2U)) & ADC_TR1_LT1;
+    }
+
+    /* AWD2 and AWD3 compare only the 8 MSBs of the conversion */
+    if (resolution == 3U) {
+        return ((uint32_t)threshold << 2U) & ADC_TR2_LT2;
+    }
+
+    /* Round inwards so every value outside the requested window is flagged. Values up to one 8 bits step inside the
+     * window may be flagged too, which is better than missing a limit crossing */
+    const uint8_t shift = 4U - resolution * 2U;
+    uint32_t reduced;
+    if (high_threshold) {
+        /* floor((high + 1) / step) - 1 */
+        reduced = ((uint32_t)threshold + 1U) >> shift;
+        reduced = reduced > 0U ? reduced - 1U : 0U;
+    } else {
+        /* ceil(low / step) */
+        reduced = ((uint32_t)threshold + (1U << shift) - 1U) >> shift;
+    }
+    /* Windows ending less than one step away from zero or full scale cannot be represented. They are saturated */
+    return reduced > ADC_TR2_LT2 ? ADC_TR2_LT2 : reduced;
+}
+
+static inline ret_status __badc_write_awd_thresholds(badc_instance_t *adc,
+                                                     badc_awd_t awd,
+                                                     uint16_t low_threshold,
+                                                     uint16_t high_threshold)
+{
+    const uint32_t low = __badc_get_awd_threshold(adc, awd, low_threshold, false);
+    const uint32_t high = __badc_get_awd_threshold(adc, awd, high_threshold, true);
+
+    if (awd == BADC_AWD_1) {
+        __BSP_SET_MASKED_REG_VALUE(adc->TR1, ADC_TR1_LT1 | ADC_TR1_HT1, low | (high << ADC_TR1_HT1_Pos));
+        /* A new window has been armed, drop any detection made against the previous one */
+        __BSP_SET_REG_VALUE(adc->ISR, ADC_ISR_AWD1);
+    } else if (awd == BADC_AWD_2) {
+        __BSP_SET_MASKED_REG_VALUE(adc->TR2, ADC_TR2_LT2 | ADC_TR2_HT2, low | (high << ADC_TR2_HT2_Pos));
+        __BSP_SET_REG_VALUE(adc->ISR, ADC_ISR_AWD2);
+    } else if (awd == BADC_AWD_3) {
+        __BSP_SET_MASKED_REG_VALUE(adc->TR3, ADC_TR3_LT3 | ADC_TR3_HT3, low | (high << ADC_TR3_HT3_Pos));
+        __BSP_SET_REG_VALUE(adc->ISR, ADC_ISR_AWD3);
+    } else {
+        return STATUS_ERR;
+    }
+
+    return STATUS_OK;
+}
+
 static inline struct __badc_irqs_state_s *__badc_get_instance_state(badc_instance_t *adc)
 {
 #if defined(ADC5)
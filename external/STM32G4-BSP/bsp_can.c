@@ -96,19 +96,20 @@ static inline ret_status __bsp_can_conf_validate_isr_group(bcan_isr_group_t isr_
  *     1. Set CCCR INIT bit to indicate that we are going to enter into initialization state. Wait until is set.
  *     2. Set CCCR CCE bit to unlock protected bits of the FDCAN registers. Wait until is set.
  *     3. Set CCCR DAR bit based on bcan_config_t::auto_retransmission value.
- *     4. Disable CAN FD and bitrate switching functionality. Protocol exception handling is disabled too since its
- *     functionality is implemented in HW for FD operation only. This version of the BSP does not support those
- *     functionalities.
- *     5. Set CCCR MON bit based on bcan_config_t::mode value. If mode is ::BCAN_MODE_BM bus
+ *     4. Set CCCR FDOE and BRSE bits based on bcan_config_t::fd_operation and bcan_config_t::bit_rate_switching.
+ *     Protocol exception handling bit (PXHD) is always cleared. If bitrate switching is enabled the data phase timing
+ *     given by bcan_config_t::data_timing is written to DBTP, using the same one-based notation as the nominal one.
+ *     5. Set TSCC TSS and TCP fields based on bcan_config_t::timestamp_source and bcan_config_t::timestamp_prescaler.
+ *     6. Set CCCR MON bit based on bcan_config_t::mode value. If mode is ::BCAN_MODE_BM bus
  *     monitor mode is enabled by writing a 1 to this bit.
- *     6. Configure peripheral nominal timing by writing NSJW, NBRP, NTSEG1 and NTSEG2 fields of NBTP register with
+ *     7. Configure peripheral nominal timing by writing NSJW, NBRP, NTSEG1 and NTSEG2 fields of NBTP register with
  *     the values provided by bcan_config_t::timing. The values given in that structure are
  *     supposed to be based on "one" index notation but registers are zero based, so all values are written subtracted
  *     by one.
- *     7. Set TXBC TFQM bit based on bcan_config_t::auto_retransmission::tx_mode. If tx_mode is set to be
+ *     8. Set TXBC TFQM bit based on bcan_config_t::auto_retransmission::tx_mode. If tx_mode is set to be
  *     ::BCAN_TX_MODE_QUEUE transmission FIFO works like a priority queue as described in chapter 44.4.4
  *     "Message RAM, Tx Queue" of RM0440.
- *     8. The whole SRAM associated to the FDCAN instance is wiped by writing zeroes to it.
+ *     9. The whole SRAM associated to the FDCAN instance is wiped by writing zeroes to it.
  *
  *     After configuring the given FDCAN instance the peripheral remains in "SW initialization" state. To put the
  *     instance in normal mode ::bcan_start should be called.
@@ -143,9 +144,27 @@ ret_status bcan_config(bcan_instance_t *can, const bcan_config_t *config)
         __BSP_SET_MASKED_REG(can->CCCR, FDCAN_CCCR_DAR);
     }
 
-    /* TODO: Now only Classic CAN is supported: Disable FDCAN operation, baudrate switching and exception handling (used
-     * only in FD operation) */
-    __BSP_CLEAR_MASKED_REG(can->CCCR, FDCAN_CCCR_FDOE | FDCAN_CCCR_BRSE | FDCAN_CCCR_PXHD);
+    /* Bitrate switching makes no sense without FD frames */
+    if (config->bit_rate_switching && !config->fd_operation) {
+        return STATUS_ERR;
+    }
+
+    /* Enable FD operation and baudrate switching if requested */
+    __BSP_SET_MASKED_REG_VALUE(can->CCCR,
+                               FDCAN_CCCR_FDOE | FDCAN_CCCR_BRSE | FDCAN_CCCR_PXHD,
+                               (config->fd_operation ? FDCAN_CCCR_FDOE : 0x00U) |
+                                   (config->bit_rate_switching ? FDCAN_CCCR_BRSE : 0x00U));
+
+    /* Prescaler only applies to the internal counter. The external one is driven by TIM3 */
+    if (config->timestamp_source == BCAN_TIMESTAMP_INTERNAL &&
+        (config->timestamp_prescaler == 0 || config->timestamp_prescaler > 16U)) {
+        return STATUS_ERR;
+    }
+    __BSP_SET_REG_VALUE(can->TSCC,
+                        config->timestamp_source |
+                            (config->timestamp_source == BCAN_TIMESTAMP_INTERNAL
+                                 ? ((config->timestamp_prescaler - 1U) << FDCAN_TSCC_TCP_Pos) & FDCAN_TSCC_TCP
+                                 : 0x00U));
 
     /* If monitor mode has been selected just turn it on */
     if (config->mode == BCAN_MODE_BM) {
@@ -168,6 +187,14 @@ ret_status bcan_config(bcan_instance_t *can, const bcan_config_t *config)
                  (((config->timing.phase2 & 0x7F) - 1U) << FDCAN_NBTP_NTSEG2_Pos) |
                  (((config->timing.prescaler & 0x01FF) - 1U) << FDCAN_NBTP_NBRP_Pos));
 
+    /* Data phase timing. Same formulas as the nominal one but with smaller fields */
+    if (config->bit_rate_switching) {
+        can->DBTP = ((((config->data_timing.sync_jump_width & 0x0F) - 1U) << FDCAN_DBTP_DSJW_Pos) |
+                     (((config->data_timing.phase1 & 0x1F) - 1U) << FDCAN_DBTP_DTSEG1_Pos) |
+                     (((config->data_timing.phase2 & 0x0F) - 1U) << FDCAN_DBTP_DTSEG2_Pos) |
+                     (((config->data_timing.prescaler & 0x1F) - 1U) << FDCAN_DBTP_DBRP_Pos));
+    }
+
     __BSP_SET_MASKED_REG_VALUE(can->TXBC, FDCAN_TXBC_TFQM, config->tx_mode);
 
     __bsp_can_configure_global_filtering(can, config);
@@ -281,6 +308,11 @@ ret_status bcan_add_tx_message(bcan_instance_t *can, const bcan_tx_metadata_t *t
         return STATUS_ERR;
     }
 
+    /* FD frames can only be sent if the peripheral has been configured for FD operation */
+    if (tx_metadata->fd_format && !__BSP_IS_FLAG_SET(can->CCCR, FDCAN_CCCR_FDOE)) {
+        return STATUS_ERR;
+    }
+
     /* Obtain the index where we will write the new message */
     const uint32_t tx_index = ((can->TXFQS & FDCAN_TXFQS_TFQPI) >> FDCAN_TXFQS_TFQPI_Pos);
 
@@ -349,6 +381,39 @@ ret_status bcan_get_rx_message(bcan_instance_t *can,
     return STATUS_OK;
 }
 
+ret_status bcan_get_tx_event(bcan_instance_t *can, bcan_tx_event_t *tx_event)
+{
+
+    /* Simple validation to avoid NULL pointers */
+    if (can == NULL || tx_event == NULL) {
+        return STATUS_ERR;
+    }
+
+    if ((can->TXEFS & FDCAN_TXEFS_EFFL) == 0) {
+        return STATUS_ERR;
+    }
+
+    struct __bcan_ram_s *instance_ram = __bsp_can_get_instance_base_address(can);
+    const uint8_t event_index = (can->TXEFS & FDCAN_TXEFS_EFGI) >> FDCAN_TXEFS_EFGI_Pos;
+    volatile struct __bcan_ram_tx_event_s *event = &instance_ram->tx_events[event_index];
+
+    const uint32_t header_word1 = event->header_word1;
+    const uint32_t header_word2 = event->header_word2;
+    tx_event->extended_id = (header_word1 & FDCAN_ELEMENT_MASK_XTD) == FDCAN_ELEMENT_MASK_XTD;
+    tx_event->id = tx_event->extended_id ? (header_word1 & FDCAN_ELEMENT_MASK_EXTID)
+                                         : ((header_word1 & FDCAN_ELEMENT_MASK_STDID) >> 18U);
+    tx_event->message_marker = (header_word2 & FDCAN_ELEMENT_MASK_MM) >> 24U;
+    tx_event->timestamp = header_word2 & FDCAN_ELEMENT_MASK_TS;
+    tx_event->size_b = (header_word2 & FDCAN_ELEMENT_MASK_DLC) >> 16U;
+    tx_event->fd_format = (header_word2 & FDCAN_ELEMENT_MASK_FDF) == FDCAN_ELEMENT_MASK_FDF;
+    tx_event->bit_rate_switch = (header_word2 & FDCAN_ELEMENT_MASK_BRS) == FDCAN_ELEMENT_MASK_BRS;
+
+    /* Release the element */
+    can->TXEFA = event_index & FDCAN_TXEFA_EFAI;
+
+    return STATUS_OK;
+}
+
 /** @brief Starts the given CAN peripheral getting the peripheral out of the software initialization state to one of the
  * possible final states. Check RM0440 to see all the possible final states.
  *
@@ -393,6 +458,27 @@ ret_status bcan_get_baudrate(bcan_instance_t *can, uint32_t *baudrate)
     return STATUS_OK;
 }
 
+bool bcan_is_fd_enabled(const bcan_instance_t *can)
+{
+    return can != NULL && __BSP_IS_FLAG_SET(can->CCCR, FDCAN_CCCR_FDOE);
+}
+
+uint8_t bcan_dlc_to_bytes(uint8_t dlc)
+{
+    return __CAN_DLC_TO_BYTE_NUMBER[dlc & 0x0FU];
+}
+
+uint8_t bcan_bytes_to_dlc(uint8_t bytes)
+{
+    /* Returns the smallest DLC able to carry the given number of bytes. Padding is up to the caller */
+    for (uint8_t dlc = 0; dlc < sizeof(__CAN_DLC_TO_BYTE_NUMBER); dlc++) {
+        if (__CAN_DLC_TO_BYTE_NUMBER[dlc] >= bytes) {
+            return dlc;
+        }
+    }
+    return sizeof(__CAN_DLC_TO_BYTE_NUMBER) - 1U;
+}
+
 ret_status bcan_config_irq_line(bcan_instance_t *can, bcan_isr_group_t isr_group, bcan_isr_line_t isr_line)
 {
 
@@ -553,7 +639,11 @@ static ret_status __bsp_copy_message_to_ram(const bcan_tx_metadata_t *pTxHeader,
 
     const uint8_t message_size = pTxHeader->size_b & 0x0FU;
     message_ram->header_word2 = (pTxHeader->message_marker << 24U) |
-                                (pTxHeader->store_tx_events ? (1 << 23) : 0x00000000U) | (message_size << 16);
+                                (pTxHeader->store_tx_events ? (1 << 23) : 0x00000000U) |
+                                (pTxHeader->fd_format ? FDCAN_ELEMENT_MASK_FDF : 0x00000000U) |
+                                (pTxHeader->fd_format && pTxHeader->bit_rate_switch ? FDCAN_ELEMENT_MASK_BRS
+                                                                                    : 0x00000000U) |
+                                (message_size << 16);
 
     uint8_t element_counter = 0;
     /* Write Tx payload to the message RAM */
@@ -586,6 +676,8 @@ static void __bsp_copy_message_from_ram(volatile struct __bcan_ram_rx_fifo_eleme
     rx_metadata->size_b = (message->header_word2 & FDCAN_ELEMENT_MASK_DLC) >> 16;
     rx_metadata->matched_filter_index = ((message->header_word2 & FDCAN_ELEMENT_MASK_FIDX) >> 24U);
     rx_metadata->non_matching_element = ((message->header_word2 & FDCAN_ELEMENT_MASK_ANMF) == FDCAN_ELEMENT_MASK_ANMF);
+    rx_metadata->fd_format = ((message->header_word2 & FDCAN_ELEMENT_MASK_FDF) == FDCAN_ELEMENT_MASK_FDF);
+    rx_metadata->bit_rate_switch = ((message->header_word2 & FDCAN_ELEMENT_MASK_BRS) == FDCAN_ELEMENT_MASK_BRS);
 
     uint8_t *pData = (uint8_t *)&message->message_payload;
     for (uint32_t byte_n = 0; byte_n < __CAN_DLC_TO_BYTE_NUMBER[rx_metadata->size_b]; byte_n++) {
@@ -0,0 +1,191 @@
+/* Copyright (C) Pablo Rodriguez Nava - All Rights Reserved
+ *       * Unauthorized copying of this file, via any medium is strictly prohibited
+ *       * Proprietary and confidential
+ * Written by Pablo Rodriguez Nava <info@pablintino.com>, January 2025
+ */
+
+#include "bsp_flash.h"
+#include "bsp_common_utils.h"
+
+#include <stdbool.h>
+
+#define __BFLASH_KEY_1 0x45670123U
+#define __BFLASH_KEY_2 0xCDEF89ABU
+
+#define __BFLASH_SR_ERRORS                                                                                             \
+    (FLASH_SR_OPERR | FLASH_SR_PROGERR | FLASH_SR_WRPERR | FLASH_SR_PGAERR | FLASH_SR_SIZERR | FLASH_SR_PGSERR |       \
+     FLASH_SR_MISERR | FLASH_SR_FASTERR | FLASH_SR_RDERR | FLASH_SR_OPTVERR)
+
+/* Worst case page erase time is 40 ms (DS12589) */
+#define __BFLASH_ERASE_TIMEOUT 50U
+#define __BFLASH_PROGRAM_TIMEOUT 5U
+
+/* Range being read by bflash_read. Double ECC errors inside it are reported instead of halting */
+static volatile uint32_t __bflash_read_start = 0;
+static volatile uint32_t __bflash_read_end = 0;
+static volatile bool __bflash_read_ecc_error = false;
+
+static ret_status __bflash_unlock(void);
+
+static inline void __bflash_lock(void);
+
+static ret_status __bflash_wait_operation(uint32_t timeout);
+
+static void __bflash_flush_caches(void);
+
+ret_status bflash_erase_page(uint32_t page)
+{
+    if (page > (FLASH_CR_PNB >> FLASH_CR_PNB_Pos)) {
+        return STATUS_ERR;
+    }
+
+    ret_status status = __bflash_unlock();
+    if (status != STATUS_OK) {
+        return status;
+    }
+
+    status = __bflash_wait_operation(__BFLASH_ERASE_TIMEOUT);
+    if (status == STATUS_OK) {
+        __BSP_SET_MASKED_REG_VALUE(FLASH->CR, FLASH_CR_PNB | FLASH_CR_PER, (page << FLASH_CR_PNB_Pos) | FLASH_CR_PER);
+        __BSP_SET_MASKED_REG(FLASH->CR, FLASH_CR_STRT);
+
+        status = __bflash_wait_operation(__BFLASH_ERASE_TIMEOUT);
+        __BSP_CLEAR_MASKED_REG(FLASH->CR, (FLASH_CR_PER | FLASH_CR_PNB));
+
+        /* Cached lines of the erased page are not valid anymore */
+        __bflash_flush_caches();
+    }
+
+    __bflash_lock();
+    return status;
+}
+
+ret_status bflash_program(uint32_t address, const uint8_t *data, uint32_t size)
+{
+    if (data == NULL || size == 0 || (address % BFLASH_PROGRAM_UNIT) != 0 || (size % BFLASH_PROGRAM_UNIT) != 0 ||
+        address < FLASH_BASE) {
+        return STATUS_ERR;
+    }
+
+    ret_status status = __bflash_unlock();
+    if (status != STATUS_OK) {
+        return status;
+    }
+
+    status = __bflash_wait_operation(__BFLASH_PROGRAM_TIMEOUT);
+    if (status == STATUS_OK) {
+        __BSP_SET_MASKED_REG(FLASH->CR, FLASH_CR_PG);
+
+        for (uint32_t offset = 0; offset < size && status == STATUS_OK; offset += BFLASH_PROGRAM_UNIT) {
+            /* The source buffer may be unaligned, compose each word byte by byte */
+            uint32_t words[2];
+            for (uint8_t index = 0; index < 2U; index++) {
+                const uint8_t *word = &data[offset + index * 4U];
+                words[index] = word[0] | (word[1] << 8U) | (word[2] << 16U) | ((uint32_t)word[3] << 24U);
+            }
+
+            /* Both words must be written back to back, the second write triggers the programming */
+            __REG32_T(address + offset) = words[0];
+            __ISB();
+            __REG32_T(address + offset + 4U) = words[1];
+
+            status = __bflash_wait_operation(__BFLASH_PROGRAM_TIMEOUT);
+        }
+
+        __BSP_CLEAR_MASKED_REG(FLASH->CR, FLASH_CR_PG);
+    }
+
+    __bflash_lock();
+    return status;
+}
+
+ret_status bflash_read(uint32_t address, uint8_t *data, uint32_t size)
+{
+    if (data == NULL || size == 0 || address < FLASH_BASE) {
+        return STATUS_ERR;
+    }
+
+    __bflash_read_ecc_error = false;
+    __bflash_read_start = address;
+    __bflash_read_end = address + size;
+    __DSB();
+
+    for (uint32_t offset = 0; offset < size; offset++) {
+        data[offset] = *(const volatile uint8_t *)(address + offset);
+    }
+
+    /* The NMI of the last read must be taken before closing the range */
+    __DSB();
+    __ISB();
+    __bflash_read_end = __bflash_read_start;
+
+    return __bflash_read_ecc_error ? STATUS_ERR : STATUS_OK;
+}
+
+void NMI_Handler(void)
+{
+    if (__BSP_IS_FLAG_SET(FLASH->ECCR, FLASH_ECCR_ECCD)) {
+        /* ADDR_ECC is the offset, in bytes, of the faulty double word */
+        const uint32_t address = FLASH_BASE + (FLASH->ECCR & FLASH_ECCR_ADDR_ECC);
+        if ((address + BFLASH_PROGRAM_UNIT) > __bflash_read_start && address < __bflash_read_end) {
+            __bflash_read_ecc_error = true;
+
+            /* Caution, this flag is cleared by writing a one. The load that faulted just returns garbage */
+            __BSP_SET_MASKED_REG(FLASH->ECCR, FLASH_ECCR_ECCD);
+            return;
+        }
+    }
+
+    /* Corrupted code or constants, clock security system... Nothing sane can be done. Same as the default handler */
+    for (;;)
+        ;
+}
+
+static ret_status __bflash_unlock(void)
+{
+    if (__BSP_IS_FLAG_SET(FLASH->CR, FLASH_CR_LOCK)) {
+        __BSP_SET_REG_VALUE(FLASH->KEYR, __BFLASH_KEY_1);
+        __BSP_SET_REG_VALUE(FLASH->KEYR, __BFLASH_KEY_2);
+    }
+
+    /* A wrong key sequence keeps the CR locked until the next reset */
+    return __BSP_IS_FLAG_SET(FLASH->CR, FLASH_CR_LOCK) ? STATUS_ERR : STATUS_OK;
+}
+
+static inline void __bflash_lock(void)
+{
+    __BSP_SET_MASKED_REG(FLASH->CR, FLASH_CR_LOCK);
+}
+
+static ret_status __bflash_wait_operation(uint32_t timeout)
+{
+    const ret_status status = butil_wait_flag_status_now(&FLASH->SR, FLASH_SR_BSY, 0U, timeout);
+
+    const uint32_t errors = FLASH->SR & __BFLASH_SR_ERRORS;
+
+    /* Caution, this register is cleared by writing ones */
+    __BSP_SET_REG_VALUE(FLASH->SR, errors | FLASH_SR_EOP);
+
+    if (status != STATUS_OK) {
+        return status;
+    }
+    return errors != 0 ? STATUS_ERR : STATUS_OK;
+}
+
+static void __bflash_flush_caches(void)
+{
+    /* Caches can only be reset while disabled */
+    if (__BSP_IS_FLAG_SET(FLASH->ACR, FLASH_ACR_ICEN)) {
+        __BSP_CLEAR_MASKED_REG(FLASH->ACR, FLASH_ACR_ICEN);
+        __BSP_SET_MASKED_REG(FLASH->ACR, FLASH_ACR_ICRST);
+        __BSP_CLEAR_MASKED_REG(FLASH->ACR, FLASH_ACR_ICRST);
+        __BSP_SET_MASKED_REG(FLASH->ACR, FLASH_ACR_ICEN);
+    }
+
+    if (__BSP_IS_FLAG_SET(FLASH->ACR, FLASH_ACR_DCEN)) {
+        __BSP_CLEAR_MASKED_REG(FLASH->ACR, FLASH_ACR_DCEN);
+        __BSP_SET_MASKED_REG(FLASH->ACR, FLASH_ACR_DCRST);
+        __BSP_CLEAR_MASKED_REG(FLASH->ACR, FLASH_ACR_DCRST);
+        __BSP_SET_MASKED_REG(FLASH->ACR, FLASH_ACR_DCEN);
+    }
+}
@@ -58,5 +58,26 @@ ret_status btick_config(uint32_t sys_frequency)
         return STATUS_ERR;
     }
     SysTick_Config(sys_frequency / (uint32_t)BSP_SYSTICK_RATE);
+    btick_cycles_init();
     return STATUS_OK;
 }
+
+void btick_cycles_init(void)
+{
+    /* The counter is left untouched if already running, so values taken before the call remain valid */
+    CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+    DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+}
+
+uint32_t btick_get_cycles(void)
+{
+    return DWT->CYCCNT;
+}
+
+void btick_wait_us_since(uint32_t start_cycles, uint32_t us)
+{
+    const uint32_t cycles_per_us = SystemCoreClock / 1000000U;
+    const uint32_t wait_cycles = us * (cycles_per_us != 0 ? cycles_per_us : 1U);
+    while ((btick_get_cycles() - start_cycles) < wait_cycles) {
+    }
+}
@@ -0,0 +1,191 @@
+/* Copyright (C) Pablo Rodriguez Nava - All Rights Reserved
+ *       * Unauthorized copying of this file, via any medium is strictly prohibited
+ *       * Proprietary and confidential
+ * Written by Pablo Rodriguez Nava <info@pablintino.com>, January 2025
+ */
+
+#include "bsp_tim.h"
+#include "bsp_clocks.h"
+#include "bsp_common_utils.h"
+#include "bsp_irq_manager.h"
+
+struct __btim_irqs_state_s {
+    btim_isr_handler_t update_handler;
+};
+
+static struct __btim_irqs_state_s __btim_internal_states[3U];
+
+static void __btim_irq_handler(btim_instance_t *tim);
+
+static inline struct __btim_irqs_state_s *__btim_get_instance_state(const btim_instance_t *tim);
+
+static inline ret_status __btim_get_irq_id(const btim_instance_t *tim, birq_irq_id *irq_id);
+
+static uint32_t __btim_get_input_frequency(void);
+
+static void __irq_handler_tim2(void)
+{
+    __btim_irq_handler(TIM2);
+}
+
+static void __irq_handler_tim3(void)
+{
+    __btim_irq_handler(TIM3);
+}
+
+#if defined(TIM4)
+static void __irq_handler_tim4(void)
+{
+    __btim_irq_handler(TIM4);
+}
+#endif
+
+ret_status btim_config(btim_instance_t *tim, const btim_config_t *config)
+{
+    if (__btim_get_instance_state(tim) == NULL || config == NULL || config->frequency == 0) {
+        return STATUS_ERR;
+    }
+
+    /* TIM2 is the only 32 bits timer of the APB1 group */
+    if (tim != TIM2 && config->period > 0xFFFFU) {
+        return STATUS_ERR;
+    }
+
+    const uint32_t input_frequency = __btim_get_input_frequency();
+    const uint32_t prescaler = input_frequency / config->frequency;
+    if (prescaler == 0 || prescaler > 0x10000U || (input_frequency % config->frequency) != 0) {
+        return STATUS_ERR;
+    }
+
+    /* Up counting, no one pulse mode. Only overflows generate update events (not the UG bit) */
+    __BSP_SET_REG_VALUE(tim->CR1, TIM_CR1_URS);
+    __BSP_SET_REG_VALUE(tim->PSC, prescaler - 1U);
+    __BSP_SET_REG_VALUE(tim->ARR, config->period);
+    __BSP_SET_REG_VALUE(tim->CNT, 0U);
+
+    /* PSC is preloaded, force an update so it takes effect from the first count */
+    __BSP_SET_REG_VALUE(tim->EGR, TIM_EGR_UG);
+    __BSP_CLEAR_MASKED_REG(tim->SR, TIM_SR_UIF);
+
+    return STATUS_OK;
+}
+
+ret_status btim_start(btim_instance_t *tim)
+{
+    if (__btim_get_instance_state(tim) == NULL) {
+        return STATUS_ERR;
+    }
+
+    __BSP_SET_MASKED_REG(tim->CR1, TIM_CR1_CEN);
+    return STATUS_OK;
+}
+
+ret_status btim_stop(btim_instance_t *tim)
+{
+    if (__btim_get_instance_state(tim) == NULL) {
+        return STATUS_ERR;
+    }
+
+    __BSP_CLEAR_MASKED_REG(tim->CR1, TIM_CR1_CEN);
+    return STATUS_OK;
+}
+
+uint32_t btim_get_counter(const btim_instance_t *tim)
+{
+    return tim->CNT;
+}
+
+bool btim_is_update_pending(const btim_instance_t *tim)
+{
+    return __BSP_IS_FLAG_SET(tim->SR, TIM_SR_UIF);
+}
+
+ret_status btim_config_update_irq(btim_instance_t *tim, btim_isr_handler_t handler)
+{
+    struct __btim_irqs_state_s *state = __btim_get_instance_state(tim);
+    birq_irq_id irq_id;
+    if (state == NULL || __btim_get_irq_id(tim, &irq_id) != STATUS_OK) {
+        return STATUS_ERR;
+    }
+
+    state->update_handler = handler;
+    if (handler == NULL) {
+        __BSP_CLEAR_MASKED_REG(tim->DIER, TIM_DIER_UIE);
+        return STATUS_OK;
+    }
+
+    bool irq_enabled;
+    birq_is_enabled(irq_id, &irq_enabled);
+    if (!irq_enabled) {
+        if (tim == TIM2) {
+            birq_set_handler(irq_id, __irq_handler_tim2);
+        } else if (tim == TIM3) {
+            birq_set_handler(irq_id, __irq_handler_tim3);
+        }
+#if defined(TIM4)
+        else {
+            birq_set_handler(irq_id, __irq_handler_tim4);
+        }
+#endif
+        birq_enable_irq_with_priority(irq_id, BSP_IRQ_MANAGER_DEFAULT_PRIORITY, BSP_IRQ_MANAGER_DEFAULT_SUB_PRIORITY);
+    }
+
+    __BSP_SET_MASKED_REG(tim->DIER, TIM_DIER_UIE);
+    return STATUS_OK;
+}
+
+static void __btim_irq_handler(btim_instance_t *tim)
+{
+    const struct __btim_irqs_state_s *state = __btim_get_instance_state(tim);
+    if (state == NULL || !__BSP_IS_FLAG_SET(tim->SR, TIM_SR_UIF)) {
+        return;
+    }
+
+    /* Caution, SR flags are cleared by writing zeroes */
+    __BSP_SET_REG_VALUE(tim->SR, ~TIM_SR_UIF);
+
+    if (state->update_handler != NULL) {
+        state->update_handler(tim);
+    }
+}
+
+static inline struct __btim_irqs_state_s *__btim_get_instance_state(const btim_instance_t *tim)
+{
+    if (tim == TIM2) {
+        return &__btim_internal_states[0U];
+    }
+    if (tim == TIM3) {
+        return &__btim_internal_states[1U];
+    }
+#if defined(TIM4)
+    if (tim == TIM4) {
+        return &__btim_internal_states[2U];
+    }
+#endif
+    return NULL;
+}
+
+static inline ret_status __btim_get_irq_id(const btim_instance_t *tim, birq_irq_id *irq_id)
+{
+    if (tim == TIM2) {
+        *irq_id = TIM2_IRQn;
+    } else if (tim == TIM3) {
+        *irq_id = TIM3_IRQn;
+    }
+#if defined(TIM4)
+    else if (tim == TIM4) {
+        *irq_id = TIM4_IRQn;
+    }
+#endif
+    else {
+        return STATUS_ERR;
+    }
+    return STATUS_OK;
+}
+
+static uint32_t __btim_get_input_frequency(void)
+{
+    /* APB1 timers are clocked at twice PCLK1 when the APB1 prescaler is not 1 */
+    const uint32_t pclk1 = bclk_get_pclk1_freq();
+    return (RCC->CFGR & RCC_CFGR_PPRE1_2) ? pclk1 * 2U : pclk1;
+}
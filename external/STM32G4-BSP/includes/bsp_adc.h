@@ -56,6 +56,8 @@ typedef enum badc_isr_type_e {
     BADC_ISR_TYPE_JQOVF = ADC_IER_JQOVFIE_Pos
 } badc_isr_type_t;
 
+typedef enum badc_awd_e { BADC_AWD_1 = 0x00U, BADC_AWD_2 = 0x01U, BADC_AWD_3 = 0x02U } badc_awd_t;
+
 typedef struct badc_config_t {
     badc_mode_t mode;
     uint8_t discontinuous_channels;
@@ -70,6 +72,49 @@ typedef struct badc_config_channel_t {
     bool differential;
 } badc_config_channel_t;
 
+/**
+ * Analog watchdog configuration.
+ *
+ * Thresholds are expressed in the units of the configured ADC resolution (right aligned conversion values). AWD1
+ * compares the full resolution value while AWD2 and AWD3 only compare the 8 MSBs of the conversion. Their thresholds
+ * are rounded towards the inside of the window: every value outside it is flagged, but values up to one 8 bits step
+ * inside it may be flagged too.
+ * The window is inclusive: the watchdog flags when a conversion is strictly lower than low_threshold or strictly
+ * higher than high_threshold.
+ */
+typedef struct badc_awd_config_t {
+    /**
+     * Bitmask of the channels guarded by the watchdog (bit n for channel n). AWD1 can guard a single channel or all the
+     * regular channels (BADC_AWD_ALL_CHANNELS), AWD2 and AWD3 can guard any channel combination.
+     */
+    uint32_t channels;
+    uint16_t low_threshold;
+    uint16_t high_threshold;
+    /**
+     * Number of consecutive out of window conversions, minus one, needed to raise the AWD flag. AWD1 only (0..7).
+     */
+    uint8_t filtering;
+} badc_awd_config_t;
+
+#define BADC_AWD_ALL_CHANNELS 0x7FFFFU
+
+/**
+ * Calibration factors as computed by the HW (CALFACT register). They can be stored and written back with
+ * ::badc_set_calibration to skip the calibration sequence in later boots.
+ */
+typedef struct badc_calibration_t {
+    uint8_t single_ended;
+    uint8_t differential;
+} badc_calibration_t;
+
+/* ADC1 channels internally connected to the temperature sensor and to VREFINT */
+#define BADC_ADC1_CHANNEL_TEMPERATURE 16U
+#define BADC_ADC1_CHANNEL_VREFINT 18U
+
+/* Startup times (DS12589), to be waited before the first conversion/calibration */
+#define BADC_REGULATOR_STARTUP_US 20U
+#define BADC_TEMPERATURE_STARTUP_US 120U
+
 typedef ADC_TypeDef badc_instance_t;
 
 typedef void (*badc_isr_handler_t)(badc_instance_t *adc, uint32_t group_flags);
@@ -86,8 +131,16 @@ ret_status badc_disable(badc_instance_t *adc);
 
 ret_status badc_calibrate(badc_instance_t *adc, bool differential);
 
+ret_status badc_get_calibration(badc_instance_t *adc, badc_calibration_t *calibration);
+
+ret_status badc_set_calibration(badc_instance_t *adc, const badc_calibration_t *calibration);
+
+ret_status badc_config_internal_channels(badc_instance_t *adc, bool vrefint, bool temperature_sensor);
+
 ret_status badc_start_conversion(badc_instance_t *adc);
 
+ret_status badc_stop_conversion(badc_instance_t *adc);
+
 ret_status badc_start_conversion_dma(
     badc_instance_t *adc, bdma_instance_t *dma, bdma_chan_t channel, uint8_t *data_address, uint16_t data_count);
 
@@ -99,4 +152,15 @@ ret_status badc_enable_irqs(badc_instance_t *adc);
 
 ret_status badc_config_irq(badc_instance_t *adc, badc_isr_type_t irq, badc_isr_handler_t handler);
 
+ret_status badc_disable_irq(badc_instance_t *adc, badc_isr_type_t irq);
+
+ret_status badc_config_awd(badc_instance_t *adc, badc_awd_t awd, const badc_awd_config_t *config);
+
+ret_status badc_set_awd_thresholds(badc_instance_t *adc,
+                                   badc_awd_t awd,
+                                   uint16_t low_threshold,
+                                   uint16_t high_threshold);
+
+ret_status badc_disable_awd(badc_instance_t *adc, badc_awd_t awd);
+
 #endif // BSP_ADC_H
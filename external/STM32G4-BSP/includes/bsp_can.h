@@ -33,6 +33,24 @@ typedef enum bcan_clock_source_e {
     BCAN_CLK_PCLK1 = 0x02U
 } bcan_clock_source_t;
 
+/**
+ * Source of the counter latched in the RX and TX event timestamps.
+ */
+typedef enum bcan_timestamp_source_e {
+    /**
+     * Timestamps are always zero.
+     */
+    BCAN_TIMESTAMP_NONE = 0x00U,
+    /**
+     * Internal 16 bits counter incremented every bcan_config_t::timestamp_prescaler nominal bit times.
+     */
+    BCAN_TIMESTAMP_INTERNAL = 0x01U << FDCAN_TSCC_TSS_Pos,
+    /**
+     * The 16 LSBs of the TIM3 counter. Allows to relate frame timestamps to a timer based time base.
+     */
+    BCAN_TIMESTAMP_EXTERNAL = 0x02U << FDCAN_TSCC_TSS_Pos
+} bcan_timestamp_source_t;
+
 typedef enum bcan_rx_queue_e { BCAN_RX_QUEUE_O = 0x00U, BCAN_RX_QUEUE_1 = 0x01U } bcan_rx_queue_t;
 
 typedef enum bcan_isr_line_e { BCAN_ISR_LINE_0 = 0x00U, BCAN_ISR_LINE_1 = 0x01U } bcan_isr_line_t;
@@ -241,6 +259,12 @@ typedef struct bcan_config_global_filters_t {
     enum bcan_non_matching_filter_e non_matching_standard_action;
 } bcan_config_global_filters_t;
 
+/**
+ * Metadata of a message to be transmitted.
+ *
+ * bcan_tx_metadata_t::size_b holds the DLC code of the message, not the number of bytes. Use ::bcan_bytes_to_dlc to
+ * obtain it from a payload length.
+ */
 typedef struct bcan_tx_metadata_t {
     uint32_t id;
     bool is_rtr;
@@ -248,17 +272,49 @@ typedef struct bcan_tx_metadata_t {
     bool store_tx_events;
     uint32_t message_marker;
     bool extended_id;
+    /**
+     * Send the message using the CAN FD format. Requires bcan_config_t::fd_operation.
+     */
+    bool fd_format;
+    /**
+     * Send the data phase at the data bitrate. Only taken into account for FD frames.
+     */
+    bool bit_rate_switch;
 } bcan_tx_metadata_t;
 
 typedef struct bcan_rx_metadata_t {
     uint32_t id;
     bool is_rtr;
     uint32_t size_b;
-    uint8_t timestamp;
+    /**
+     * Value of the timestamp counter latched at the start of the frame. See bcan_config_t::timestamp_source.
+     */
+    uint16_t timestamp;
     uint8_t matched_filter_index;
     bool non_matching_element;
+    bool fd_format;
+    bool bit_rate_switch;
 } bcan_rx_metadata_t;
 
+/**
+ * Transmission event, stored for every sent message that had bcan_tx_metadata_t::store_tx_events set.
+ */
+typedef struct bcan_tx_event_t {
+    uint32_t id;
+    bool extended_id;
+    uint32_t size_b;
+    /**
+     * Copy of the bcan_tx_metadata_t::message_marker of the sent message.
+     */
+    uint8_t message_marker;
+    /**
+     * Value of the timestamp counter latched at the start of the frame. See bcan_config_t::timestamp_source.
+     */
+    uint16_t timestamp;
+    bool fd_format;
+    bool bit_rate_switch;
+} bcan_tx_event_t;
+
 typedef struct bcan_standard_filter_t {
     enum bcan_standard_filter_type_e type;
     enum bcan_filter_action_e action;
@@ -303,6 +359,26 @@ typedef struct bcan_config_timing_t {
 
 typedef struct bcan_config_t {
     bcan_config_timing_t timing;
+    /**
+     * Timing of the data phase of FD frames. Only used if bcan_config_t::bit_rate_switching is enabled.
+     */
+    bcan_config_timing_t data_timing;
+    /**
+     * Enables CAN FD frames (up to 64 bytes payload).
+     */
+    bool fd_operation;
+    /**
+     * Enables bitrate switching for FD frames. Requires bcan_config_t::fd_operation.
+     */
+    bool bit_rate_switching;
+    /**
+     * Counter latched in RX and TX event timestamps.
+     */
+    bcan_timestamp_source_t timestamp_source;
+    /**
+     * Bit times per internal timestamp counter increment (1-16). Only used by ::BCAN_TIMESTAMP_INTERNAL.
+     */
+    uint8_t timestamp_prescaler;
     bool auto_retransmission;
     bcan_mode_source_t mode;
     bcan_tx_mode_t tx_mode;
@@ -336,6 +412,14 @@ ret_status bcan_get_rx_message(bcan_instance_t *can,
                                bcan_rx_metadata_t *rx_metadata,
                                uint8_t *rx_data);
 
+ret_status bcan_get_tx_event(bcan_instance_t *can, bcan_tx_event_t *tx_event);
+
 ret_status bcan_get_baudrate(bcan_instance_t *can, uint32_t *baudrate);
 
+bool bcan_is_fd_enabled(const bcan_instance_t *can);
+
+uint8_t bcan_dlc_to_bytes(uint8_t dlc);
+
+uint8_t bcan_bytes_to_dlc(uint8_t bytes);
+
 #endif // BSP_CAN_H
@@ -110,6 +110,9 @@ enum bsp_clk_enable_clock {
     ENI2C2 = __BSP_BIT_ADDR_OFF_32(offsetof(RCC_TypeDef, APB1ENR1), 22),  /*!< I2C2 Enable */
     ENI2C3 = __BSP_BIT_ADDR_OFF_32(offsetof(RCC_TypeDef, APB1ENR1), 30),  /*!< I2C2 Enable */
     ENFDCAN = __BSP_BIT_ADDR_OFF_32(offsetof(RCC_TypeDef, APB1ENR1), 25), /*!< FDCAN Enable */
+    ENTIM2 = __BSP_BIT_ADDR_OFF_32(offsetof(RCC_TypeDef, APB1ENR1), 0),   /*!< TIM2 Enable */
+    ENTIM3 = __BSP_BIT_ADDR_OFF_32(offsetof(RCC_TypeDef, APB1ENR1), 1),   /*!< TIM3 Enable */
+    ENTIM4 = __BSP_BIT_ADDR_OFF_32(offsetof(RCC_TypeDef, APB1ENR1), 2),   /*!< TIM4 Enable */
     ENADC12 = __BSP_BIT_ADDR_OFF_32(offsetof(RCC_TypeDef, AHB2ENR), 13),  /*!< ADC 1 and 2 Enable */
     ENADC345 = __BSP_BIT_ADDR_OFF_32(offsetof(RCC_TypeDef, AHB2ENR), 14), /*!< ADC 3, 4 and 5 Enable */
     ENDMA1 = __BSP_BIT_ADDR_OFF_32(offsetof(RCC_TypeDef, AHB1ENR), 0),    /*!< DMA1 Enable */
@@ -0,0 +1,33 @@
+/* Copyright (C) Pablo Rodriguez Nava - All Rights Reserved
+ *       * Unauthorized copying of this file, via any medium is strictly prohibited
+ *       * Proprietary and confidential
+ * Written by Pablo Rodriguez Nava <info@pablintino.com>, January 2025
+ */
+
+#ifndef BSP_FLASH_H
+#define BSP_FLASH_H
+
+#include "bsp_types.h"
+#include "stm32g4xx.h"
+
+/* Single bank organization (DBANK=0 or category 2 devices): 2 KB pages */
+#define BFLASH_PAGE_SIZE 0x800U
+/* Flash is programmed by double words. Addresses and sizes must be multiples of this value */
+#define BFLASH_PROGRAM_UNIT 8U
+
+#define BFLASH_ADDRESS_TO_PAGE(ADDRESS) (((ADDRESS)-FLASH_BASE) / BFLASH_PAGE_SIZE)
+
+ret_status bflash_erase_page(uint32_t page);
+
+ret_status bflash_program(uint32_t address, const uint8_t *data, uint32_t size);
+
+/**
+ * Copies flash contents to RAM, surviving double ECC errors.
+ *
+ * A power loss while erasing or programming can leave double words that fail the ECC check. Reading them raises a
+ * NMI, that the BSP handler absorbs only if the faulty address belongs to an ongoing bflash_read. In that case the
+ * copied data is garbage and STATUS_ERR is returned. Any other NMI halts as the default handler does.
+ */
+ret_status bflash_read(uint32_t address, uint8_t *data, uint32_t size);
+
+#endif // BSP_FLASH_H
@@ -20,4 +20,9 @@ uint32_t btick_get_ticks(void);
 void btick_delay(uint32_t delay);
 ret_status btick_config(uint32_t sys_frequency);
 
+/* Free running core cycle counter (DWT CYCCNT). Wraps every 2^32 core cycles */
+void btick_cycles_init(void);
+uint32_t btick_get_cycles(void);
+void btick_wait_us_since(uint32_t start_cycles, uint32_t us);
+
 #endif // BSP_TICK_H
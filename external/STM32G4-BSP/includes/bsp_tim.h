@@ -0,0 +1,47 @@
+/* Copyright (C) Pablo Rodriguez Nava - All Rights Reserved
+ *       * Unauthorized copying of this file, via any medium is strictly prohibited
+ *       * Proprietary and confidential
+ * Written by Pablo Rodriguez Nava <info@pablintino.com>, January 2025
+ */
+
+/**
+ * @file bsp_tim.h
+ * @brief Minimal time base driver for the APB1 general purpose timers (TIM2, TIM3 and TIM4).
+ *
+ * Timers are configured as free running up counters. No capture/compare channels are handled.
+ */
+#ifndef BSP_TIM_H
+#define BSP_TIM_H
+
+#include "bsp_types.h"
+#include "stm32g4xx.h"
+#include <stdbool.h>
+
+typedef TIM_TypeDef btim_instance_t;
+
+typedef void (*btim_isr_handler_t)(btim_instance_t *tim);
+
+typedef struct btim_config_t {
+    /**
+     * Counter frequency in Hz. The timer input clock must be an integer multiple of it.
+     */
+    uint32_t frequency;
+    /**
+     * Auto-reload value. The counter wraps to zero after reaching it. Only TIM2 accepts values above 0xFFFF.
+     */
+    uint32_t period;
+} btim_config_t;
+
+ret_status btim_config(btim_instance_t *tim, const btim_config_t *config);
+
+ret_status btim_start(btim_instance_t *tim);
+
+ret_status btim_stop(btim_instance_t *tim);
+
+uint32_t btim_get_counter(const btim_instance_t *tim);
+
+bool btim_is_update_pending(const btim_instance_t *tim);
+
+ret_status btim_config_update_irq(btim_instance_t *tim, btim_isr_handler_t handler);
+
+#endif // BSP_TIM_H
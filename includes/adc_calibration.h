@@ -0,0 +1,49 @@
+/* Copyright (C) Pablo Rodriguez Nava - All Rights Reserved
+ *       * Unauthorized copying of this file, via any medium is strictly prohibited
+ *       * Proprietary and confidential
+ * Written by Pablo Rodriguez Nava <info@pablintino.com>, January 2025
+ */
+
+/**
+ * @file adc_calibration.h
+ * @brief ADC calibration factors persisted in the last flash page.
+ *
+ * The stored record keeps the calibration factors together with the internal temperature sensor and VREFINT
+ * conversions taken right after the calibration. In later boots the factors are restored only if the record CRC is
+ * valid and both internal conversions are still within tolerance, otherwise the ADC is calibrated again.
+ *
+ * Storing a new record erases a flash page, which stalls the CPU for tens of milliseconds. It is deferred until
+ * ::acal_store is called, so the caller can do it once the time critical part of the boot is done. A power loss in the
+ * middle of it leaves a page with ECC errors, read through bflash_read so it is just taken as an invalid record and the
+ * next boot calibrates (and stores) again.
+ */
+#ifndef ADC_CALIBRATION_H
+#define ADC_CALIBRATION_H
+
+#include "bsp_adc.h"
+#include <stdbool.h>
+
+/* Around 10 ºC at 3.3 V (2.5 mV/ºC) */
+#define ACAL_TEMPERATURE_TOLERANCE 30U
+/* Around 1% of VDDA */
+#define ACAL_VREFINT_TOLERANCE 15U
+
+typedef enum acal_result_e {
+    ACAL_RESULT_RESTORED = 0x00U,
+    ACAL_RESULT_CALIBRATED = 0x01U
+} acal_result_t;
+
+/**
+ * Restores or computes the ADC1 calibration.
+ *
+ * The ADC must be configured (regulator enabled) with its internal temperature sensor and VREFINT channels enabled
+ * and settled. The ADC is left enabled with the regular sequence used for the internal measurements, the caller is
+ * expected to configure its own channels afterwards.
+ */
+ret_status acal_calibrate(badc_instance_t *adc, acal_result_t *result);
+
+bool acal_is_store_pending(void);
+
+ret_status acal_store(void);
+
+#endif // ADC_CALIBRATION_H
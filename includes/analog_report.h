@@ -0,0 +1,72 @@
+/* Copyright (C) Pablo Rodriguez Nava - All Rights Reserved
+ *       * Unauthorized copying of this file, via any medium is strictly prohibited
+ *       * Proprietary and confidential
+ * Written by Pablo Rodriguez Nava <info@pablintino.com>, June 2021
+ */
+
+/**
+ * @file analog_report.h
+ * @brief Report-on-change logic for the analog inputs.
+ *
+ * Instead of sending the analog values at a fixed rate a new report is only requested when a channel moves more than
+ * its deadband from the last reported value, when it crosses one of its alarm limits or when the heartbeat expires.
+ * Reports are rate limited by arep_config_t::min_interval. The windows returned by ::arep_get_window are meant to be
+ * programmed in the ADC analog watchdogs so changes are detected by HW without polling.
+ *
+ * A watchdog event is only a reason to look at the samples again, the deadband and the alarm limits decide if a report
+ * is sent. HW windows can be narrower than the deadband (coarse watchdog thresholds) and an input sitting between both
+ * would, otherwise, produce a report every min_interval. After such events ::arep_rearm_watchdogs holds the watchdogs
+ * disarmed for min_interval, so they cannot wake up the caller more often than that.
+ */
+#ifndef ANALOG_REPORT_H
+#define ANALOG_REPORT_H
+
+#include "bsp_types.h"
+#include <stdbool.h>
+
+#define AREP_MAX_CHANNELS 4U
+#define AREP_WAIT_FOREVER 0xFFFFFFFFU
+
+typedef struct arep_channel_config_t {
+    /* Values lower than alarm_low or higher than alarm_high are reported as alarms */
+    uint16_t alarm_low;
+    uint16_t alarm_high;
+    /* Maximum change, in ADC counts, not worth a new report */
+    uint16_t deadband;
+} arep_channel_config_t;
+
+typedef struct arep_config_t {
+    arep_channel_config_t channels[AREP_MAX_CHANNELS];
+    uint8_t channel_count;
+    /* Minimum number of ticks between two consecutive reports */
+    uint32_t min_interval;
+    /* Maximum number of ticks without a report. Zero disables the heartbeat */
+    uint32_t heartbeat_interval;
+} arep_config_t;
+
+typedef struct arep_state_t {
+    arep_config_t config;
+    uint16_t reported[AREP_MAX_CHANNELS];
+    uint32_t reported_alarms;
+    uint32_t last_report_tick;
+    bool has_reported;
+    volatile bool event_pending;
+    bool watchdogs_armed;
+    uint32_t watchdog_event_tick;
+} arep_state_t;
+
+ret_status arep_init(arep_state_t *state, const arep_config_t *config);
+
+void arep_notify_event(arep_state_t *state);
+
+bool arep_evaluate(arep_state_t *state, const uint16_t *samples, uint32_t now, uint32_t *next_wait);
+
+void arep_commit(arep_state_t *state, const uint16_t *samples, uint32_t now);
+
+bool arep_rearm_watchdogs(arep_state_t *state, uint32_t now);
+
+uint32_t arep_get_alarms(const arep_state_t *state);
+
+ret_status arep_get_window(const arep_state_t *state, uint8_t channel, uint16_t *low, uint16_t *high);
+
+#endif // ANALOG_REPORT_H
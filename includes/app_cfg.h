@@ -7,9 +7,12 @@
 #ifndef APP_CFG_H
 #define APP_CFG_H
 
-#define APP_CFG_BYTE_POOL_SIZE 2*1024u
+#define APP_CFG_BYTE_POOL_SIZE 4*1024u
 #define APP_CFG_TASK_START_STK_SIZE 512u
 #define APP_CFG_TASK_OBJ_STK_SIZE 512u
+#define APP_CFG_TASK_ISOTP_STK_SIZE 1024u
 #define APP_CFG_TASK_OBJ_PRIO 10u
+/* Set to 1 in the node that acts as time reference of the bus. The rest of the nodes follow it */
+#define APP_CFG_TSYNC_MASTER 0u
 
 #endif // APP_CFG_H
@@ -16,6 +16,7 @@
 #include "bsp_irq_manager.h"
 #include "bsp_os.h"
 #include "bsp_tick.h"
+#include "bsp_tim.h"
 #include "bsp_usart.h"
 
 void board_init(void);
@@ -0,0 +1,47 @@
+/* Copyright (C) Pablo Rodriguez Nava - All Rights Reserved
+ *       * Unauthorized copying of this file, via any medium is strictly prohibited
+ *       * Proprietary and confidential
+ * Written by Pablo Rodriguez Nava <info@pablintino.com>, January 2025
+ */
+
+/**
+ * @file boot_profile.h
+ * @brief Boot phase instrumentation.
+ *
+ * Each ::bprof_mark records the microseconds elapsed since ::bprof_start (called at the very beginning of main) up to
+ * the end of the given phase. Timestamps come from the core cycle counter, converted with the core clock in use when
+ * the previous mark was taken, so phases spanning a clock switch are accounted at the clock they mostly ran at.
+ * Time from reset to main (startup code) is not accounted.
+ */
+#ifndef BOOT_PROFILE_H
+#define BOOT_PROFILE_H
+
+#include "bsp_types.h"
+
+#define BPROF_NOT_REACHED 0xFFFFFFFFU
+
+typedef enum bprof_phase_e {
+    BPROF_PHASE_MAIN = 0x00U,
+    BPROF_PHASE_CLOCKS,
+    BPROF_PHASE_KERNEL,
+    BPROF_PHASE_ADC_POWER_UP,
+    BPROF_PHASE_USART,
+    BPROF_PHASE_I2C,
+    BPROF_PHASE_CAN,
+    BPROF_PHASE_DMA,
+    BPROF_PHASE_ADC,
+    BPROF_PHASE_PERIPHERALS_ENABLED,
+    BPROF_PHASE_TASKS_CREATED,
+    BPROF_PHASE_FIRST_FRAME,
+    BPROF_PHASE_COUNT
+} bprof_phase_t;
+
+void bprof_start(void);
+
+void bprof_mark(bprof_phase_t phase);
+
+uint32_t bprof_get_us(bprof_phase_t phase);
+
+void bprof_dump(void);
+
+#endif // BOOT_PROFILE_H
@@ -0,0 +1,29 @@
+/* Copyright (C) Pablo Rodriguez Nava - All Rights Reserved
+ *       * Unauthorized copying of this file, via any medium is strictly prohibited
+ *       * Proprietary and confidential
+ * Written by Pablo Rodriguez Nava <info@pablintino.com>, January 2025
+ */
+
+/**
+ * @file timebase.h
+ * @brief Local 64 bits microsecond time base.
+ *
+ * Built on top of a 16 bits timer running at 1 MHz whose overflows are counted in SW. TIM3 is the timer to use, as
+ * its counter is the one latched by the FDCAN external timestamps: frame timestamps can be converted to the same time
+ * base by ::tbase_extend_capture. The overflow counter is 32 bits wide, so the time base wraps after 2^48 us (almost
+ * 9 years).
+ */
+#ifndef TIMEBASE_H
+#define TIMEBASE_H
+
+#include "bsp_tim.h"
+
+#define TBASE_FREQUENCY 1000000U
+
+ret_status tbase_init(btim_instance_t *tim);
+
+uint64_t tbase_now_us(void);
+
+uint64_t tbase_extend_capture(uint16_t capture);
+
+#endif // TIMEBASE_H
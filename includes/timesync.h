@@ -0,0 +1,95 @@
+/* Copyright (C) Pablo Rodriguez Nava - All Rights Reserved
+ *       * Unauthorized copying of this file, via any medium is strictly prohibited
+ *       * Proprietary and confidential
+ * Written by Pablo Rodriguez Nava <info@pablintino.com>, January 2025
+ */
+
+/**
+ * @file timesync.h
+ * @brief Master/slave time synchronization over CAN.
+ *
+ * Two step protocol, in the spirit of gPTP and AUTOSAR CanTSyn, on a single CAN ID. Frames follow the TIME_SYNC
+ * layout of analog_io.dbc: a SYNC (TYPE 1) and a FOLLOW_UP (TYPE 2) that carries, in MASTER_TIME, the master time in
+ * us at the start of the SYNC frame. Both share a 4 bits SEQUENCE to pair them.
+ *
+ * The master sends a SYNC every tsync_config_t::sync_interval and, once its TX timestamp is known, the matching
+ * FOLLOW_UP. Slaves timestamp the SYNC reception and pair both values to know the offset between their local time base
+ * and the master one. The rate difference between clocks is estimated from consecutive syncs and applied between
+ * them. CAN propagation delay (tens of ns on a short bus) is not compensated.
+ *
+ * Like the ISO-TP layer, the module is HW agnostic: frames are sent through a ::tsync_link_t and all times are local
+ * time base microseconds given by the caller.
+ */
+#ifndef TIMESYNC_H
+#define TIMESYNC_H
+
+#include "bsp_types.h"
+#include <stdbool.h>
+
+typedef enum tsync_role_e { TSYNC_ROLE_MASTER = 0x00U, TSYNC_ROLE_SLAVE = 0x01U } tsync_role_t;
+
+/**
+ * Link used to send the sync frames.
+ *
+ * A non zero marker means the TX timestamp of the frame is needed. It has to be given back, together with the marker,
+ * through ::tsync_on_tx_timestamp once the frame has been sent.
+ */
+typedef struct tsync_link_t {
+    ret_status (*send_frame)(
+        void *context, uint32_t id, bool extended_id, const uint8_t *data, uint8_t size, uint8_t marker);
+    void *context;
+} tsync_link_t;
+
+typedef struct tsync_config_t {
+    tsync_role_t role;
+    uint32_t id;
+    bool extended_id;
+    /**
+     * Master only. Time between two SYNC frames, in us.
+     */
+    uint32_t sync_interval;
+    /**
+     * Slave only. Offsets larger than this, in us, step the time instead of being used for drift estimation.
+     */
+    uint32_t step_threshold;
+    /**
+     * Slave only. Time without a valid sync, in us, after which the node is not considered synchronized anymore.
+     */
+    uint32_t timeout;
+} tsync_config_t;
+
+typedef struct tsync_state_t {
+    tsync_config_t config;
+    const tsync_link_t *link;
+
+    uint8_t sequence;
+    uint64_t next_sync;
+    bool sync_pending_tx;
+    bool follow_up_pending;
+    uint64_t follow_up_time;
+
+    bool sync_received;
+    uint8_t sync_sequence;
+    uint64_t sync_local;
+
+    bool synchronized;
+    bool has_reference;
+    uint64_t reference_local;
+    uint64_t reference_global;
+    int32_t drift_ppb;
+    uint64_t last_sync_local;
+} tsync_state_t;
+
+ret_status tsync_init(tsync_state_t *state, const tsync_config_t *config, const tsync_link_t *link);
+
+uint64_t tsync_poll(tsync_state_t *state, uint64_t now);
+
+ret_status tsync_on_frame(tsync_state_t *state, const uint8_t *data, uint8_t size, uint64_t rx_time);
+
+void tsync_on_tx_timestamp(tsync_state_t *state, uint8_t marker, uint64_t tx_time);
+
+uint64_t tsync_to_global(const tsync_state_t *state, uint64_t local);
+
+bool tsync_is_synchronized(const tsync_state_t *state);
+
+#endif // TIMESYNC_H
@@ -0,0 +1,193 @@
+/* Copyright (C) Pablo Rodriguez Nava - All Rights Reserved
+ *       * Unauthorized copying of this file, via any medium is strictly prohibited
+ *       * Proprietary and confidential
+ * Written by Pablo Rodriguez Nava <info@pablintino.com>, January 2025
+ */
+
+#include "adc_calibration.h"
+#include "bsp_flash.h"
+
+#define __ACAL_RECORD_MAGIC 0x4C414341U
+#define __ACAL_RECORD_VERSION 0x01U
+#define __ACAL_CONVERSION_TIMEOUT 5U
+
+struct __acal_record_s {
+    uint32_t magic;
+    uint8_t version;
+    uint8_t single_ended;
+    uint8_t differential;
+    uint8_t reserved;
+    uint16_t temperature;
+    uint16_t vrefint;
+    /* CRC-32 of all the previous fields */
+    uint32_t crc;
+};
+
+/* Defined by the linker script */
+extern const uint8_t _calib_start[];
+
+static struct __acal_record_s __acal_pending_record;
+static bool __acal_store_pending = false;
+
+static ret_status __acal_measure(badc_instance_t *adc, uint16_t *temperature, uint16_t *vrefint);
+
+static bool __acal_is_record_valid(const struct __acal_record_s *record);
+
+static inline bool __acal_is_within(uint16_t value, uint16_t reference, uint16_t tolerance);
+
+static uint32_t __acal_crc32(const uint8_t *data, uint32_t size);
+
+ret_status acal_calibrate(badc_instance_t *adc, acal_result_t *result)
+{
+    if (adc != ADC1 || result == NULL) {
+        /* Internal channels are only wired to ADC1 */
+        return STATUS_ERR;
+    }
+
+    uint16_t temperature;
+    uint16_t vrefint;
+    ret_status status;
+
+    /* Never read in place. A store interrupted by a power loss leaves ECC errors that only bflash_read survives */
+    struct __acal_record_s stored;
+    if (bflash_read((uint32_t)_calib_start, (uint8_t *)&stored, sizeof(stored)) == STATUS_OK &&
+        __acal_is_record_valid(&stored)) {
+        status = badc_enable(adc);
+        if (status != STATUS_OK) {
+            return status;
+        }
+
+        const badc_calibration_t calibration = {stored.single_ended, stored.differential};
+        status = badc_set_calibration(adc, &calibration);
+        if (status != STATUS_OK) {
+            return status;
+        }
+
+        status = __acal_measure(adc, &temperature, &vrefint);
+        if (status != STATUS_OK) {
+            return status;
+        }
+
+        if (__acal_is_within(temperature, stored.temperature, ACAL_TEMPERATURE_TOLERANCE) &&
+            __acal_is_within(vrefint, stored.vrefint, ACAL_VREFINT_TOLERANCE)) {
+            *result = ACAL_RESULT_RESTORED;
+            return STATUS_OK;
+        }
+    }
+
+    /* No valid record or conditions changed too much since it was taken */
+    status = badc_calibrate(adc, false);
+    if (status != STATUS_OK) {
+        return status;
+    }
+
+    status = badc_enable(adc);
+    if (status != STATUS_OK) {
+        return status;
+    }
+
+    badc_calibration_t calibration;
+    status = badc_get_calibration(adc, &calibration);
+    if (status != STATUS_OK) {
+        return status;
+    }
+
+    status = __acal_measure(adc, &temperature, &vrefint);
+    if (status != STATUS_OK) {
+        return status;
+    }
+
+    __acal_pending_record.magic = __ACAL_RECORD_MAGIC;
+    __acal_pending_record.version = __ACAL_RECORD_VERSION;
+    __acal_pending_record.single_ended = calibration.single_ended;
+    __acal_pending_record.differential = calibration.differential;
+    __acal_pending_record.reserved = 0xFFU;
+    __acal_pending_record.temperature = temperature;
+    __acal_pending_record.vrefint = vrefint;
+    __acal_pending_record.crc = __acal_crc32((const uint8_t *)&__acal_pending_record,
+                                             offsetof(struct __acal_record_s, crc));
+    __acal_store_pending = true;
+
+    *result = ACAL_RESULT_CALIBRATED;
+    return STATUS_OK;
+}
+
+bool acal_is_store_pending(void)
+{
+    return __acal_store_pending;
+}
+
+ret_status acal_store(void)
+{
+    if (!__acal_store_pending) {
+        return STATUS_OK;
+    }
+
+    const uint32_t address = (uint32_t)_calib_start;
+    ret_status status = bflash_erase_page(BFLASH_ADDRESS_TO_PAGE(address));
+    if (status != STATUS_OK) {
+        return status;
+    }
+
+    status = bflash_program(address, (const uint8_t *)&__acal_pending_record, sizeof(__acal_pending_record));
+    if (status == STATUS_OK) {
+        __acal_store_pending = false;
+    }
+    return status;
+}
+
+static ret_status __acal_measure(badc_instance_t *adc, uint16_t *temperature, uint16_t *vrefint)
+{
+    /* Longest sampling time, both sensors need several us to be sampled */
+    const badc_config_channel_t channels[2] = {
+        {BADC_ADC1_CHANNEL_TEMPERATURE, BADC_SAMPLING_TIME_640_5, false},
+        {BADC_ADC1_CHANNEL_VREFINT, BADC_SAMPLING_TIME_640_5, false},
+    };
+    ret_status status = badc_config_channels(adc, channels, 2);
+    if (status != STATUS_OK) {
+        return status;
+    }
+
+    status = badc_start_conversion(adc);
+    if (status != STATUS_OK) {
+        return status;
+    }
+
+    status = badc_wait_conversion(adc, __ACAL_CONVERSION_TIMEOUT);
+    if (status == STATUS_OK) {
+        *temperature = badc_get_conversion(adc);
+        status = badc_wait_conversion(adc, __ACAL_CONVERSION_TIMEOUT);
+    }
+    if (status == STATUS_OK) {
+        *vrefint = badc_get_conversion(adc);
+    }
+
+    /* In continuous mode the sequence would be converted over and over */
+    const ret_status stop_status = badc_stop_conversion(adc);
+    return status != STATUS_OK ? status : stop_status;
+}
+
+static bool __acal_is_record_valid(const struct __acal_record_s *record)
+{
+    return record->magic == __ACAL_RECORD_MAGIC && record->version == __ACAL_RECORD_VERSION &&
+           record->crc == __acal_crc32((const uint8_t *)record, offsetof(struct __acal_record_s, crc));
+}
+
+static inline bool __acal_is_within(uint16_t value, uint16_t reference, uint16_t tolerance)
+{
+    const uint16_t delta = value > reference ? value - reference : reference - value;
+    return delta <= tolerance;
+}
+
+static uint32_t __acal_crc32(const uint8_t *data, uint32_t size)
+{
+    /* Plain bitwise CRC-32 (IEEE 802.3). The record is a handful of bytes, no need for a table */
+    uint32_t crc = 0xFFFFFFFFU;
+    for (uint32_t index = 0; index < size; index++) {
+        crc ^= data[index];
+        for (uint8_t bit = 0; bit < 8U; bit++) {
+            crc = (crc >> 1U) ^ (0xEDB88320U & (0U - (crc & 1U)));
+        }
+    }
+    return ~crc;
+}
@@ -0,0 +1,174 @@
+/* Copyright (C) Pablo Rodriguez Nava - All Rights Reserved
+ *       * Unauthorized copying of this file, via any medium is strictly prohibited
+ *       * Proprietary and confidential
+ * Written by Pablo Rodriguez Nava <info@pablintino.com>, June 2021
+ */
+
+#include "analog_report.h"
+
+static inline uint32_t __arep_compute_alarms(const arep_state_t *state, const uint16_t *samples);
+
+static inline bool __arep_exceeds_deadband(const arep_state_t *state, const uint16_t *samples);
+
+ret_status arep_init(arep_state_t *state, const arep_config_t *config)
+{
+    if (state == NULL || config == NULL || config->channel_count == 0 || config->channel_count > AREP_MAX_CHANNELS) {
+        return STATUS_ERR;
+    }
+
+    for (uint8_t index = 0; index < config->channel_count; index++) {
+        if (config->channels[index].alarm_low > config->channels[index].alarm_high) {
+            return STATUS_ERR;
+        }
+    }
+
+    state->config = *config;
+    state->reported_alarms = 0;
+    state->last_report_tick = 0;
+    state->has_reported = false;
+    state->event_pending = false;
+    state->watchdogs_armed = false;
+    state->watchdog_event_tick = 0;
+    for (uint8_t index = 0; index < AREP_MAX_CHANNELS; index++) {
+        state->reported[index] = 0;
+    }
+
+    return STATUS_OK;
+}
+
+void arep_notify_event(arep_state_t *state)
+{
+    /* Called from the ADC watchdog ISRs, that mask the watchdogs. Samples are checked by the next arep_evaluate */
+    state->event_pending = true;
+}
+
+bool arep_evaluate(arep_state_t *state, const uint16_t *samples, uint32_t now, uint32_t *next_wait)
+{
+    const uint32_t elapsed = now - state->last_report_tick;
+
+    if (state->event_pending) {
+        state->event_pending = false;
+        state->watchdogs_armed = false;
+        state->watchdog_event_tick = now;
+    }
+
+    bool report_needed = !state->has_reported || __arep_compute_alarms(state, samples) != state->reported_alarms ||
+                         __arep_exceeds_deadband(state, samples);
+
+    /* The heartbeat keeps the remote side aware of our presence even if the inputs are static */
+    if (!report_needed && state->config.heartbeat_interval != 0 && elapsed >= state->config.heartbeat_interval) {
+        report_needed = true;
+    }
+
+    if (report_needed && state->has_reported && elapsed < state->config.min_interval) {
+        /* Rate limited. Come back when the minimum interval expires */
+        *next_wait = state->config.min_interval - elapsed;
+        return false;
+    }
+
+    if (report_needed) {
+        *next_wait = state->config.heartbeat_interval != 0 ? state->config.heartbeat_interval : AREP_WAIT_FOREVER;
+    } else {
+        *next_wait = state->config.heartbeat_interval != 0 ? state->config.heartbeat_interval - elapsed
+                                                           : AREP_WAIT_FOREVER;
+
+        /* Watchdogs held disarmed after an event that didn't need a report. Come back to re-arm them */
+        const uint32_t since_event = now - state->watchdog_event_tick;
+        if (!state->watchdogs_armed && since_event < state->config.min_interval &&
+            state->config.min_interval - since_event < *next_wait) {
+            *next_wait = state->config.min_interval - since_event;
+        }
+    }
+    return report_needed;
+}
+
+void arep_commit(arep_state_t *state, const uint16_t *samples, uint32_t now)
+{
+    for (uint8_t index = 0; index < state->config.channel_count; index++) {
+        state->reported[index] = samples[index];
+    }
+    state->reported_alarms = __arep_compute_alarms(state, samples);
+    state->last_report_tick = now;
+    state->has_reported = true;
+    state->event_pending = false;
+
+    /* New windows, watchdogs can be re-armed right away */
+    state->watchdogs_armed = false;
+    state->watchdog_event_tick = now - state->config.min_interval;
+}
+
+bool arep_rearm_watchdogs(arep_state_t *state, uint32_t now)
+{
+    if (state->watchdogs_armed || (now - state->watchdog_event_tick) < state->config.min_interval) {
+        return false;
+    }
+
+    state->watchdogs_armed = true;
+    return true;
+}
+
+uint32_t arep_get_alarms(const arep_state_t *state)
+{
+    return state->reported_alarms;
+}
+
+ret_status arep_get_window(const arep_state_t *state, uint8_t channel, uint16_t *low, uint16_t *high)
+{
+    if (state == NULL || low == NULL || high == NULL || channel >= state->config.channel_count) {
+        return STATUS_ERR;
+    }
+
+    const arep_channel_config_t *channel_config = &state->config.channels[channel];
+    const uint16_t reported = state->reported[channel];
+
+    /* Deadband window centered in the last reported value */
+    uint32_t window_low = reported > channel_config->deadband ? (uint32_t)(reported - channel_config->deadband) : 0U;
+    uint32_t window_high = (uint32_t)reported + channel_config->deadband;
+
+    /* Shrink the window so crossing an alarm limit is detected even if the change is smaller than the deadband. The
+     * window is inclusive, values outside [window_low, window_high] are the ones that trigger */
+    if (reported < channel_config->alarm_low) {
+        if (window_high >= channel_config->alarm_low) {
+            window_high = channel_config->alarm_low - 1U;
+        }
+    } else if (reported > channel_config->alarm_high) {
+        if (window_low <= channel_config->alarm_high) {
+            window_low = channel_config->alarm_high + 1U;
+        }
+    } else {
+        if (window_low < channel_config->alarm_low) {
+            window_low = channel_config->alarm_low;
+        }
+        if (window_high > channel_config->alarm_high) {
+            window_high = channel_config->alarm_high;
+        }
+    }
+
+    *low = (uint16_t)window_low;
+    *high = window_high > 0xFFFFU ? 0xFFFFU : (uint16_t)window_high;
+    return STATUS_OK;
+}
+
+static inline uint32_t __arep_compute_alarms(const arep_state_t *state, const uint16_t *samples)
+{
+    uint32_t alarms = 0;
+    for (uint8_t index = 0; index < state->config.channel_count; index++) {
+        if (samples[index] < state->config.channels[index].alarm_low ||
+            samples[index] > state->config.channels[index].alarm_high) {
+            alarms |= (1U << index);
+        }
+    }
+    return alarms;
+}
+
+static inline bool __arep_exceeds_deadband(const arep_state_t *state, const uint16_t *samples)
+{
+    for (uint8_t index = 0; index < state->config.channel_count; index++) {
+        const uint16_t reported = state->reported[index];
+        const uint16_t delta = samples[index] > reported ? samples[index] - reported : reported - samples[index];
+        if (delta > state->config.channels[index].deadband) {
+            return true;
+        }
+    }
+    return false;
+}
@@ -5,6 +5,9 @@
  */
 
 #include "board.h"
+#include "adc_calibration.h"
+#include "boot_profile.h"
+#include "timebase.h"
 
 #include <SEGGER_RTT.h>
 
@@ -16,6 +19,8 @@ static ret_status __configure_i2c(void);
 
 static ret_status __configure_can(void);
 
+static ret_status __power_up_adc(uint32_t *sensors_enabled_cycles);
+
 static ret_status __configure_adc(void);
 
 static ret_status __configure_dma(void);
@@ -39,15 +44,29 @@ void board_init(void)
     bclk_enable_periph_clock(ENI2C3);
     bclk_enable_periph_clock(ENUSART1);
     bclk_enable_periph_clock(ENFDCAN);
+    bclk_enable_periph_clock(ENTIM3);
     bclk_enable_periph_clock(ENADC12);
 
-    ret_status temp_status = __configure_usart();
+    /* The ADC regulator and the internal sensors need some time before the ADC can be calibrated. Power them up
+     * first and let them settle while the rest of the peripherals are configured */
+    uint32_t sensors_enabled_cycles;
+    ret_status temp_status = __power_up_adc(&sensors_enabled_cycles);
+    if (temp_status != STATUS_OK) {
+        SEGGER_RTT_WriteString(0, "[ERR] Failed to power up ADC\r\n");
+        while (1) {
+            ;
+        };
+    }
+    bprof_mark(BPROF_PHASE_ADC_POWER_UP);
+
+    temp_status = __configure_usart();
     if (temp_status != STATUS_OK) {
         SEGGER_RTT_WriteString(0, "[ERR] Failed to configure USART\r\n");
         while (1) {
             ;
         };
     }
+    bprof_mark(BPROF_PHASE_USART);
 
     temp_status = __configure_i2c();
     if (temp_status != STATUS_OK) {
@@ -56,6 +75,7 @@ void board_init(void)
             ;
         };
     }
+    bprof_mark(BPROF_PHASE_I2C);
 
     temp_status = __configure_can();
     if (temp_status != STATUS_OK) {
@@ -64,22 +84,28 @@ void board_init(void)
             ;
         };
     }
+    bprof_mark(BPROF_PHASE_CAN);
 
-    temp_status = __configure_adc();
+    temp_status = __configure_dma();
     if (temp_status != STATUS_OK) {
-        SEGGER_RTT_WriteString(0, "[ERR] Failed to configure ADC\r\n");
+        SEGGER_RTT_WriteString(0, "[ERR] Failed to configure DMA\r\n");
         while (1) {
             ;
         };
     }
+    bprof_mark(BPROF_PHASE_DMA);
 
-    temp_status = __configure_dma();
+    /* Usually already elapsed at this point */
+    btick_wait_us_since(sensors_enabled_cycles, BADC_TEMPERATURE_STARTUP_US);
+
+    temp_status = __configure_adc();
     if (temp_status != STATUS_OK) {
-        SEGGER_RTT_WriteString(0, "[ERR] Failed to configure DMA\r\n");
+        SEGGER_RTT_WriteString(0, "[ERR] Failed to configure ADC\r\n");
         while (1) {
             ;
         };
     }
+    bprof_mark(BPROF_PHASE_ADC);
 
     SEGGER_RTT_WriteString(0, "[INFO] Enabling USART1\r\n");
     busart_enable(USART1);
@@ -90,9 +116,8 @@ void board_init(void)
     SEGGER_RTT_WriteString(0, "[INFO] Enabling FDCAN1\r\n");
     bcan_start(FDCAN1);
 
-    /* TODO Just here for consistency, but ADC can be enable just with the first conversion too */
-    SEGGER_RTT_WriteString(0, "[INFO] Enabling ADC1\r\n");
-    badc_enable(ADC1);
+    /* ADC1 is already enabled, calibration leaves it ready to convert */
+    bprof_mark(BPROF_PHASE_PERIPHERALS_ENABLED);
 }
 
 static ret_status __configure_i2c(void)
@@ -120,7 +145,7 @@ static ret_status __configure_dma(void)
 
     bdma_config_t dma_config = {0};
     dma_config.request = BDMA_REQ_ID_ADC1;
-    dma_config.circular_mode = false;
+    dma_config.circular_mode = true;
     dma_config.memory_increment = true;
     dma_config.peripheral_increment = false;
     dma_config.direction = BDMA_XFER_DIR_P2M;
@@ -136,14 +161,15 @@ static ret_status __configure_dma(void)
     return bdma_enable_irq(DMA1, BDMA_CHANNEL_1);
 }
 
-static ret_status __configure_adc(void)
+static ret_status __power_up_adc(uint32_t *sensors_enabled_cycles)
 {
 
     bio_config_analog_port(GPIOA, BSP_IO_PIN_3 | BSP_IO_PIN_2, BSP_IO_NO_PU_PD);
     badc_config_clk_source(ADC1, BADC_CLK_SYSCLK);
 
     badc_config_t adc_config = {0};
-    adc_config.mode = BADC_MODE_NORMAL;
+    /* Convert continuously so the analog watchdogs can flag changes as soon as they happen */
+    adc_config.mode = BADC_MODE_CONTINUOUS;
     adc_config.resolution = BADC_RESOLUTON_12_BITS;
     adc_config.dma_circular_mode = true;
 
@@ -152,20 +178,53 @@ static ret_status __configure_adc(void)
         return tmp_status;
     }
 
+    /* Used to validate the stored calibration. Their startup time counts from here */
+    tmp_status = badc_config_internal_channels(ADC1, true, true);
+    *sensors_enabled_cycles = btick_get_cycles();
+    return tmp_status;
+}
+
+static ret_status __configure_adc(void)
+{
+
+    acal_result_t calibration_result;
+    ret_status tmp_status = acal_calibrate(ADC1, &calibration_result);
+    if (tmp_status != STATUS_OK) {
+        return tmp_status;
+    }
+    SEGGER_RTT_WriteString(0,
+                           calibration_result == ACAL_RESULT_RESTORED ? "[INFO] ADC calibration restored\r\n"
+                                                                      : "[INFO] ADC calibrated\r\n");
+
+    /* In continuous mode the sampling time alone sets the conversion rate. 640.5 + 12.5 cycles at 48 MHz are 13.6 us
+     * per conversion, ~36.7 kHz per channel, still far faster than the 1 ms the report task works with. 2.5 cycles
+     * would mean 3.2 M DMA transfers per second fighting the CPU for the bus, and ~50 ns for the sampling capacitor to
+     * settle, too short for anything but a very low impedance source */
     badc_config_channel_t adc_channel_configs[2];
     adc_channel_configs[0].channel_number = 4;
     adc_channel_configs[0].differential = false;
-    adc_channel_configs[0].sampling_time = BADC_SAMPLING_TIME_2_5;
+    adc_channel_configs[0].sampling_time = BADC_SAMPLING_TIME_640_5;
     adc_channel_configs[1].channel_number = 3;
     adc_channel_configs[1].differential = false;
-    adc_channel_configs[1].sampling_time = BADC_SAMPLING_TIME_2_5;
+    adc_channel_configs[1].sampling_time = BADC_SAMPLING_TIME_640_5;
     tmp_status = badc_config_channels(
         ADC1, &adc_channel_configs[0], sizeof(adc_channel_configs) / sizeof(badc_config_channel_t));
     if (tmp_status != STATUS_OK) {
         return tmp_status;
     }
 
-    tmp_status = badc_calibrate(ADC1, false);
+    /* Watchdogs start with a full scale window. The report layer narrows them after the first report */
+    badc_awd_config_t awd_config = {0};
+    awd_config.channels = 1U << adc_channel_configs[0].channel_number;
+    awd_config.low_threshold = 0x0000U;
+    awd_config.high_threshold = 0x0FFFU;
+    tmp_status = badc_config_awd(ADC1, BADC_AWD_1, &awd_config);
+    if (tmp_status != STATUS_OK) {
+        return tmp_status;
+    }
+
+    awd_config.channels = 1U << adc_channel_configs[1].channel_number;
+    tmp_status = badc_config_awd(ADC1, BADC_AWD_2, &awd_config);
     if (tmp_status != STATUS_OK) {
         return tmp_status;
     }
@@ -178,6 +237,12 @@ static ret_status __configure_can(void)
 
     bio_config_af_port(GPIOA, BSP_IO_PIN_11 | BSP_IO_PIN_12, 9, BSP_IO_NO_PU_PD, BSP_IO_VERY_HIGH, BSP_IO_OUT_TYPE_PP);
 
+    /* FDCAN timestamps frames with the TIM3 counter, so they share the time base used by the time sync */
+    ret_status tmp_status = tbase_init(TIM3);
+    if (tmp_status != STATUS_OK) {
+        return tmp_status;
+    }
+
     bcan_config_t can_config = {0};
     can_config.tx_mode = BCAN_TX_MODE_FIFO;
     can_config.mode = BCAN_MODE_NORMAL;
@@ -188,10 +253,11 @@ static ret_status __configure_can(void)
     can_config.auto_retransmission = false;
     can_config.global_filters.non_matching_standard_action = BCAN_NON_MATCHING_ACCEPT_RX_0;
     can_config.global_filters.reject_remote_standard = true;
+    can_config.timestamp_source = BCAN_TIMESTAMP_EXTERNAL;
 
     bcan_config_clk_source(BCAN_CLK_PCLK1);
 
-    ret_status tmp_status = bcan_config(FDCAN1, &can_config);
+    tmp_status = bcan_config(FDCAN1, &can_config);
     if (tmp_status != STATUS_OK) {
         return tmp_status;
     }
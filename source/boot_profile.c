@@ -0,0 +1,93 @@
+/* Copyright (C) Pablo Rodriguez Nava - All Rights Reserved
+ *       * Unauthorized copying of this file, via any medium is strictly prohibited
+ *       * Proprietary and confidential
+ * Written by Pablo Rodriguez Nava <info@pablintino.com>, January 2025
+ */
+
+#include "boot_profile.h"
+#include "bsp_tick.h"
+#include "stm32g4xx.h"
+
+#include <SEGGER_RTT.h>
+
+static struct {
+    uint32_t marks[BPROF_PHASE_COUNT];
+    uint32_t last_cycles;
+    uint32_t cycles_per_us;
+    uint32_t remainder_cycles;
+    uint32_t elapsed_us;
+} __bprof_state;
+
+static const char *const __bprof_phase_names[BPROF_PHASE_COUNT] = {
+    "main",
+    "clocks",
+    "kernel",
+    "adc power up",
+    "usart",
+    "i2c",
+    "can",
+    "dma",
+    "adc",
+    "peripherals enabled",
+    "tasks created",
+    "first frame",
+};
+
+static inline uint32_t __bprof_get_cycles_per_us(void);
+
+void bprof_start(void)
+{
+    btick_cycles_init();
+
+    for (uint8_t index = 0; index < BPROF_PHASE_COUNT; index++) {
+        __bprof_state.marks[index] = BPROF_NOT_REACHED;
+    }
+    __bprof_state.remainder_cycles = 0;
+    __bprof_state.elapsed_us = 0;
+    __bprof_state.cycles_per_us = __bprof_get_cycles_per_us();
+    __bprof_state.last_cycles = btick_get_cycles();
+    __bprof_state.marks[BPROF_PHASE_MAIN] = 0;
+}
+
+void bprof_mark(bprof_phase_t phase)
+{
+    if (phase >= BPROF_PHASE_COUNT) {
+        return;
+    }
+
+    const uint32_t now = btick_get_cycles();
+
+    /* Accumulate in us instead of cycles so the clock can change between marks. Keep the remainder to not drift */
+    const uint32_t cycles = (now - __bprof_state.last_cycles) + __bprof_state.remainder_cycles;
+    __bprof_state.elapsed_us += cycles / __bprof_state.cycles_per_us;
+    __bprof_state.remainder_cycles = cycles % __bprof_state.cycles_per_us;
+    __bprof_state.last_cycles = now;
+    __bprof_state.cycles_per_us = __bprof_get_cycles_per_us();
+
+    __bprof_state.marks[phase] = __bprof_state.elapsed_us;
+}
+
+uint32_t bprof_get_us(bprof_phase_t phase)
+{
+    return phase < BPROF_PHASE_COUNT ? __bprof_state.marks[phase] : BPROF_NOT_REACHED;
+}
+
+void bprof_dump(void)
+{
+    uint32_t previous = 0;
+    for (uint8_t index = 0; index < BPROF_PHASE_COUNT; index++) {
+        const uint32_t mark = __bprof_state.marks[index];
+        if (mark == BPROF_NOT_REACHED) {
+            SEGGER_RTT_printf(0, "[BOOT] %s: not reached\r\n", __bprof_phase_names[index]);
+            continue;
+        }
+        SEGGER_RTT_printf(0, "[BOOT] %s: %u us (+%u us)\r\n", __bprof_phase_names[index], mark, mark - previous);
+        previous = mark;
+    }
+}
+
+static inline uint32_t __bprof_get_cycles_per_us(void)
+{
+    const uint32_t cycles_per_us = SystemCoreClock / 1000000U;
+    return cycles_per_us != 0 ? cycles_per_us : 1U;
+}
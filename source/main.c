@@ -5,11 +5,20 @@
  */
 
 #include "main.h"
+#include "adc_calibration.h"
+#include "analog_io_signals.h"
+#include "analog_report.h"
+#include "boot_profile.h"
 #include "build_defs.h"
+#include "isotp.h"
+#include "timebase.h"
+#include "timesync.h"
 #include "version_numbers.h"
 
+#include "bsp_common_utils.h"
 #include "tx_api.h"
 #include <SEGGER_RTT.h>
+#include <string.h>
 
 static UCHAR tx_byte_pool_buffer[APP_CFG_BYTE_POOL_SIZE] __attribute__((aligned(4U)));
 static TX_BYTE_POOL tx_app_byte_pool;
@@ -17,12 +26,31 @@ static TX_BYTE_POOL tx_app_byte_pool;
 TX_THREAD TX_thread_adc_sync;
 TX_THREAD TX_thread_0;
 TX_THREAD TX_thread_start;
+TX_THREAD TX_thread_isotp;
 TX_SEMAPHORE TX_adc_sync_sem;
+TX_SEMAPHORE TX_can_rx_sem;
 
 static uint8_t aRxBuffer[2];
 static uint8_t aTxBuffer[2];
 
-static uint16_t adc_dma_conversions[2];
+static volatile uint16_t adc_dma_conversions[2];
+
+static arep_state_t analog_report;
+
+#define ISOTP_RX_ID 0x77200U
+#define ISOTP_TX_ID 0x77201U
+#define ISOTP_REQUEST_VERSION 0x01U
+
+static isotp_channel_t isotp_channels[1];
+static uint8_t isotp_request_buffer[256];
+static uint8_t isotp_response_buffer[256];
+
+#define TSYNC_SYNC_INTERVAL_US 100000U
+#define TSYNC_STEP_THRESHOLD_US 1000U
+#define TSYNC_TIMEOUT_US 1000000U
+#define TSYNC_US_PER_TICK (TBASE_FREQUENCY / BSP_SYSTICK_RATE)
+
+static tsync_state_t time_sync;
 
 const unsigned char completeVersion[] = {VERSION_MAJOR_INIT,
                                          '.',
@@ -51,7 +79,6 @@ const unsigned char completeVersion[] = {VERSION_MAJOR_INIT,
                                          BUILD_SEC_CH1,
                                          '\0'};
 
-uint32_t test_n = 0;
 static void AppTaskObj0(ULONG p_arg)
 {
     (void)p_arg;
@@ -61,6 +88,9 @@ static void AppTaskObj0(ULONG p_arg)
 
     // SEGGER_RTT_WriteString(0, "SEGGER Real-Time-Terminal Sample\r\n");
 
+    /* Give the sensor time to power up. Waited here so it doesn't delay the rest of the boot */
+    btick_delay(100);
+
     bio_write_port(GPIOA, 5, 1);
     //  i2c_transfer7(I2C3, 0x90U, &aTxBuffer, 1, &aRxBuffer, 2);
     ret_status status1 = bi2c_master_transfer(I2C3, 0x90U, aTxBuffer, 1, true, 1000);
@@ -98,71 +128,239 @@ static void AppTaskObj0(ULONG p_arg)
     }
 }
 
+void adc_awd_handler(badc_instance_t *adc, uint32_t flags)
+{
+    (void)flags;
+
+    /* Watchdogs keep flagging while the input stays out of the window. Masked until the report task re-arms them */
+    badc_disable_irq(adc, BADC_ISR_TYPE_AWD1);
+    badc_disable_irq(adc, BADC_ISR_TYPE_AWD2);
+
+    arep_notify_event(&analog_report);
+    tx_semaphore_put(&TX_adc_sync_sem);
+}
+
+static void arm_analog_watchdogs(void)
+{
+    uint16_t low;
+    uint16_t high;
+
+    /* Channel 0 is guarded by AWD1 and channel 1 by AWD2. Re-arming also clears any stale watchdog flag */
+    if (arep_get_window(&analog_report, 0, &low, &high) == STATUS_OK) {
+        badc_set_awd_thresholds(ADC1, BADC_AWD_1, low, high);
+        badc_config_irq(ADC1, BADC_ISR_TYPE_AWD1, adc_awd_handler);
+    }
+    if (arep_get_window(&analog_report, 1, &low, &high) == STATUS_OK) {
+        badc_set_awd_thresholds(ADC1, BADC_AWD_2, low, high);
+        badc_config_irq(ADC1, BADC_ISR_TYPE_AWD2, adc_awd_handler);
+    }
+}
+
 static void AppTaskCanTX(ULONG p_arg)
 {
     (void)p_arg;
 
-    bcan_tx_metadata_t test;
-    test.id = 0x77ff;
-    test.extended_id=true;
-    test.is_rtr = false;
-    test.size_b = 4;
-    test.store_tx_events = false;
-    test.message_marker = 0x00;
+    /* Layout given by analog_io.dbc. Frames larger than 8 bytes go out as FD ones */
+    bcan_tx_metadata_t report_metadata = {0};
+    report_metadata.id = AIO_ADC_REPORT_ID;
+    report_metadata.extended_id = AIO_ADC_REPORT_EXTENDED_ID;
+    report_metadata.size_b = bcan_bytes_to_dlc(AIO_ADC_REPORT_SIZE);
+    report_metadata.fd_format = AIO_ADC_REPORT_SIZE > 8U;
+    report_metadata.bit_rate_switch = report_metadata.fd_format;
+
+    arep_config_t report_config = {0};
+    report_config.channel_count = 2;
+    report_config.min_interval = 5;
+    report_config.heartbeat_interval = 1000;
+    for (uint8_t index = 0; index < report_config.channel_count; index++) {
+        report_config.channels[index].alarm_low = 0x0100U;
+        report_config.channels[index].alarm_high = 0x0F00U;
+        report_config.channels[index].deadband = 0x0010U;
+    }
+    if (arep_init(&analog_report, &report_config) != STATUS_OK) {
+        for (;;)
+            ;
+    }
 
+    uint32_t wait = TX_NO_WAIT;
+    bool first_frame_sent = false;
     for (;;) {
-        btick_delay(500);
-
-        badc_start_conversion_dma(ADC1, DMA1, BDMA_CHANNEL_1, (uint8_t *)&adc_dma_conversions, 2);
+        /* Woken up by the ADC watchdogs or when the heartbeat/rate limit period expires */
+        tx_semaphore_get(&TX_adc_sync_sem, wait);
+
+        const uint16_t samples[2] = {adc_dma_conversions[0], adc_dma_conversions[1]};
+        /* ADC converts continuously, so the samples are, at most, one conversion older than this */
+        const uint64_t sample_time = tsync_to_global(&time_sync, tbase_now_us());
+        const uint32_t now = btick_get_ticks();
+        if (!arep_evaluate(&analog_report, samples, now, &wait)) {
+            /* The ISR masked the watchdogs. Re-armed here too, even if the event didn't end up in a report */
+            if (arep_rearm_watchdogs(&analog_report, now)) {
+                arm_analog_watchdogs();
+            }
+            continue;
+        }
 
-        tx_semaphore_get(&TX_adc_sync_sem, TX_WAIT_FOREVER);
-        // DMA conversions of both enabled channels. We discard one to add the CAN rx counter
-        //uint32_t conversion_value = adc_dma_conversions[0] | (adc_dma_conversions[1] << 16);
-        uint32_t conversion_value = adc_dma_conversions[0] | (test_n << 16);
-        if (bcan_add_tx_message(FDCAN1, &test, (const uint8_t *)&conversion_value) != STATUS_OK) {
+        arep_commit(&analog_report, samples, now);
+        const uint32_t alarms = arep_get_alarms(&analog_report);
+        aio_adc_report_t report;
+        report.ch0 = samples[0];
+        report.ch1 = samples[1];
+        report.alarm_ch0 = alarms & 0x01U;
+        report.alarm_ch1 = (alarms >> 1U) & 0x01U;
+        report.synchronized = tsync_is_synchronized(&time_sync);
+        /* 32 LSBs are enough to align frames from different nodes (wraps every ~71 minutes) */
+        report.timestamp = (uint32_t)sample_time;
+
+        uint8_t payload[AIO_ADC_REPORT_SIZE];
+        aio_adc_report_pack(payload, &report);
+        if (bcan_add_tx_message(FDCAN1, &report_metadata, payload) != STATUS_OK) {
             SEGGER_RTT_WriteString(0, "CAN Tx failure\r\n");
+        } else if (!first_frame_sent) {
+            first_frame_sent = true;
+            bprof_mark(BPROF_PHASE_FIRST_FRAME);
+            bprof_dump();
+
+            /* Erasing flash stalls the whole MCU. Done once the first frame is out instead of during the boot */
+            if (acal_is_store_pending() && acal_store() != STATUS_OK) {
+                SEGGER_RTT_WriteString(0, "[ERR] Failed to store ADC calibration\r\n");
+            }
+        }
+
+        if (arep_rearm_watchdogs(&analog_report, now)) {
+            arm_analog_watchdogs();
         }
     }
 }
 
 void can_rx_handler(bcan_instance_t *can, uint32_t group_flags)
 {
+    (void)can;
     (void)group_flags;
 
-    bcan_rx_metadata_t rx_metadata;
-    uint8_t rx_data[64];
-    if (bcan_get_rx_message(can, BCAN_RX_QUEUE_O, &rx_metadata, rx_data) == STATUS_OK) {
-        test_n++;
-    }
+    /* Frames and TX events are drained by the ISO-TP task. A single pending wake up is enough */
+    tx_semaphore_ceiling_put(&TX_can_rx_sem, 1);
 }
 
-void adc_eos_handler(badc_instance_t *adc, uint32_t flags)
+static ret_status isotp_can_send_frame(void *context, uint32_t id, bool extended_id, const uint8_t *data, uint8_t size)
 {
-    (void)adc;
-    (void)flags;
+    bcan_tx_metadata_t metadata = {0};
+    metadata.id = id;
+    metadata.extended_id = extended_id;
+    metadata.size_b = bcan_bytes_to_dlc(size);
+    metadata.fd_format = size > ISOTP_CLASSIC_FRAME_SIZE;
+    metadata.bit_rate_switch = metadata.fd_format;
+    return bcan_add_tx_message((bcan_instance_t *)context, &metadata, data);
+}
 
-    tx_semaphore_put(&TX_adc_sync_sem);
+static const isotp_link_t isotp_can_link = {isotp_can_send_frame, FDCAN1};
+
+static ret_status tsync_can_send_frame(
+    void *context, uint32_t id, bool extended_id, const uint8_t *data, uint8_t size, uint8_t marker)
+{
+    bcan_tx_metadata_t metadata = {0};
+    metadata.id = id;
+    metadata.extended_id = extended_id;
+    metadata.size_b = bcan_bytes_to_dlc(size);
+    /* The TX event FIFO gives back the timestamp of the frames the sync layer asks for */
+    metadata.store_tx_events = marker != 0U;
+    metadata.message_marker = marker;
+    return bcan_add_tx_message((bcan_instance_t *)context, &metadata, data);
 }
 
-void dma_xfer_complete_handler(bdma_instance_t *dma, bdma_channel_instance_t *channel, uint32_t group_flags)
+static const tsync_link_t tsync_can_link = {tsync_can_send_frame, FDCAN1};
+
+static void isotp_request_handler(isotp_channel_t *channel, isotp_result_t result, uint8_t *data, uint32_t size)
 {
-    (void)dma;
-    (void)channel;
-    (void)group_flags;
+    if (result != ISOTP_RESULT_OK || size == 0) {
+        return;
+    }
 
-    tx_semaphore_put(&TX_adc_sync_sem);
+    /* Previous response still on its way. Requests are not queued */
+    if (channel->tx_state != ISOTP_TX_STATE_IDLE) {
+        return;
+    }
+
+    uint32_t response_size;
+    if (data[0] == ISOTP_REQUEST_VERSION) {
+        response_size = sizeof(completeVersion);
+        memcpy(isotp_response_buffer, completeVersion, response_size);
+    } else {
+        /* Any other request is echoed back. Useful to check the transport from the other side */
+        response_size = size;
+        memcpy(isotp_response_buffer, data, response_size);
+    }
+    isotp_send(channel, isotp_response_buffer, response_size, btick_get_ticks());
+}
+
+static void AppTaskIsoTp(ULONG p_arg)
+{
+    (void)p_arg;
+
+    isotp_channel_config_t isotp_config = {0};
+    isotp_config.tx_id = ISOTP_TX_ID;
+    isotp_config.rx_id = ISOTP_RX_ID;
+    isotp_config.extended_id = true;
+    /* Use 64 bytes frames if the bus has been configured for FD operation */
+    isotp_config.frame_size = bcan_is_fd_enabled(FDCAN1) ? ISOTP_MAX_FRAME_SIZE : ISOTP_CLASSIC_FRAME_SIZE;
+    isotp_config.block_size = 0;
+    isotp_config.st_min = 0;
+    isotp_config.timeout = 1000;
+    isotp_config.padding = 0xCC;
+    isotp_config.rx_handler = isotp_request_handler;
+    if (isotp_init(&isotp_channels[0], &isotp_config, &isotp_can_link) != STATUS_OK ||
+        isotp_set_rx_buffer(&isotp_channels[0], isotp_request_buffer, sizeof(isotp_request_buffer)) != STATUS_OK) {
+        for (;;)
+            ;
+    }
+
+    bcan_rx_metadata_t rx_metadata;
+    bcan_tx_event_t tx_event;
+    uint8_t rx_data[64];
+    uint32_t wait = TX_NO_WAIT;
+    for (;;) {
+        /* Woken up by received frames, TX events or when ISO-TP or the time sync need to be polled */
+        tx_semaphore_get(&TX_can_rx_sem, wait);
+
+        const uint32_t now = btick_get_ticks();
+        while (bcan_get_rx_message(FDCAN1, BCAN_RX_QUEUE_O, &rx_metadata, rx_data) == STATUS_OK) {
+            const uint8_t size = bcan_dlc_to_bytes(rx_metadata.size_b);
+            if (rx_metadata.id == AIO_TIME_SYNC_ID) {
+                tsync_on_frame(&time_sync, rx_data, size, tbase_extend_capture(rx_metadata.timestamp));
+            } else {
+                isotp_dispatch_frame(
+                    isotp_channels, BSP_UTL_COUNT_OF(isotp_channels), rx_metadata.id, rx_data, size, now);
+            }
+        }
+
+        while (bcan_get_tx_event(FDCAN1, &tx_event) == STATUS_OK) {
+            tsync_on_tx_timestamp(&time_sync, tx_event.message_marker, tbase_extend_capture(tx_event.timestamp));
+        }
+
+        /* Transfers in progress need to be polled every tick to honor STmin and timeouts */
+        bool busy = false;
+        for (uint8_t index = 0; index < BSP_UTL_COUNT_OF(isotp_channels); index++) {
+            isotp_poll(&isotp_channels[index], now);
+            busy |= isotp_is_busy(&isotp_channels[index]);
+        }
+
+        const uint64_t now_us = tbase_now_us();
+        const uint64_t deadline = tsync_poll(&time_sync, now_us);
+        if (busy || deadline <= now_us) {
+            wait = 1;
+        } else if (deadline - now_us >= (uint64_t)TSYNC_US_PER_TICK * TX_WAIT_FOREVER) {
+            wait = TX_WAIT_FOREVER;
+        } else {
+            wait = (uint32_t)((deadline - now_us + TSYNC_US_PER_TICK - 1U) / TSYNC_US_PER_TICK);
+        }
+    }
 }
 
 static void AppStart(ULONG p_arg)
 {
     (void)p_arg;
 
-    btick_delay(100);
+    bprof_mark(BPROF_PHASE_KERNEL);
     board_init();
-    bcan_config_irq(FDCAN1, BCAN_IRQ_TYPE_RF0NE, can_rx_handler);
-    // badc_config_irq(ADC1, BADC_ISR_TYPE_EOS, adc_eos_handler);
-
-    bdma_config_irq(DMA1, BDMA_CHANNEL_1, BDMA_ISR_TYPE_XFER_COMPL, dma_xfer_complete_handler);
 
     /* -2- Configure IO in output push-pull mode to drive external LEDs */
     bio_conf_output_port(GPIOA, BSP_IO_PIN_4 | BSP_IO_PIN_5 | BSP_IO_PIN_6, BSP_IO_PU, BSP_IO_HIGH, BSP_IO_OUT_TYPE_PP);
@@ -176,6 +374,32 @@ static void AppStart(ULONG p_arg)
             ;
     }
 
+    if (tx_semaphore_create(&TX_can_rx_sem, "can rx sem", 0) != TX_SUCCESS) {
+        for (;;)
+            ;
+    }
+    bcan_config_irq(FDCAN1, BCAN_IRQ_TYPE_RF0NE, can_rx_handler);
+    bcan_config_irq(FDCAN1, BCAN_IRQ_TYPE_TEFNE, can_rx_handler);
+
+    /* Initialized before the tasks start as the report one converts its timestamps to the global time */
+    tsync_config_t tsync_config = {0};
+    tsync_config.role = APP_CFG_TSYNC_MASTER ? TSYNC_ROLE_MASTER : TSYNC_ROLE_SLAVE;
+    tsync_config.id = AIO_TIME_SYNC_ID;
+    tsync_config.extended_id = AIO_TIME_SYNC_EXTENDED_ID;
+    tsync_config.sync_interval = TSYNC_SYNC_INTERVAL_US;
+    tsync_config.step_threshold = TSYNC_STEP_THRESHOLD_US;
+    tsync_config.timeout = TSYNC_TIMEOUT_US;
+    if (tsync_init(&time_sync, &tsync_config, &tsync_can_link) != STATUS_OK) {
+        for (;;)
+            ;
+    }
+
+    /* ADC converts continuously into the circular DMA buffer. The report task just picks the latest values */
+    if (badc_start_conversion_dma(ADC1, DMA1, BDMA_CHANNEL_1, (uint8_t *)adc_dma_conversions, 2) != STATUS_OK) {
+        for (;;)
+            ;
+    }
+
     char *stack_can_tx_thread;
     if (tx_byte_allocate(&tx_app_byte_pool, (void **)&stack_can_tx_thread, APP_CFG_TASK_OBJ_STK_SIZE, TX_NO_WAIT) !=
         TX_SUCCESS) {
@@ -196,6 +420,26 @@ static void AppStart(ULONG p_arg)
             ;
     }
 
+    char *stack_isotp_thread;
+    if (tx_byte_allocate(&tx_app_byte_pool, (void **)&stack_isotp_thread, APP_CFG_TASK_ISOTP_STK_SIZE, TX_NO_WAIT) !=
+        TX_SUCCESS) {
+        for (;;)
+            ;
+    }
+    if (tx_thread_create(&TX_thread_isotp,
+                         "ISO-TP Task",
+                         AppTaskIsoTp,
+                         0,
+                         stack_isotp_thread,
+                         APP_CFG_TASK_ISOTP_STK_SIZE,
+                         APP_CFG_TASK_OBJ_PRIO,
+                         APP_CFG_TASK_OBJ_PRIO,
+                         TX_NO_TIME_SLICE,
+                         TX_AUTO_START) != TX_SUCCESS) {
+        for (;;)
+            ;
+    }
+
     char *stack_app0_thread;
     if (tx_byte_allocate(&tx_app_byte_pool, (void **)&stack_app0_thread, APP_CFG_TASK_OBJ_STK_SIZE, TX_NO_WAIT) !=
         TX_SUCCESS) {
@@ -215,6 +459,8 @@ static void AppStart(ULONG p_arg)
         for (;;)
             ;
     }
+
+    bprof_mark(BPROF_PHASE_TASKS_CREATED);
 }
 void tx_application_define(VOID *first_unused_memory)
 {
@@ -249,9 +495,12 @@ void tx_application_define(VOID *first_unused_memory)
 
 int main(void)
 {
+    bprof_start();
+
     SEGGER_RTT_printf(0, "### Analog-IO SW Version %s@pablintino ###\r\n", completeVersion);
 
     board_early_init();
+    bprof_mark(BPROF_PHASE_CLOCKS);
     tx_kernel_enter();
 
     for (;;)
@@ -0,0 +1,76 @@
+/* Copyright (C) Pablo Rodriguez Nava - All Rights Reserved
+ *       * Unauthorized copying of this file, via any medium is strictly prohibited
+ *       * Proprietary and confidential
+ * Written by Pablo Rodriguez Nava <info@pablintino.com>, January 2025
+ */
+
+#include "timebase.h"
+
+#define __TBASE_COUNTER_BITS 16U
+#define __TBASE_COUNTER_MASK 0xFFFFU
+
+static btim_instance_t *__tbase_timer = NULL;
+static volatile uint32_t __tbase_overflows = 0;
+
+static void __tbase_overflow_handler(btim_instance_t *tim);
+
+ret_status tbase_init(btim_instance_t *tim)
+{
+    btim_config_t config = {0};
+    config.frequency = TBASE_FREQUENCY;
+    config.period = __TBASE_COUNTER_MASK;
+
+    ret_status status = btim_config(tim, &config);
+    if (status != STATUS_OK) {
+        return status;
+    }
+
+    __tbase_timer = tim;
+    __tbase_overflows = 0;
+
+    status = btim_config_update_irq(tim, __tbase_overflow_handler);
+    if (status != STATUS_OK) {
+        return status;
+    }
+    return btim_start(tim);
+}
+
+uint64_t tbase_now_us(void)
+{
+    if (__tbase_timer == NULL) {
+        return 0;
+    }
+
+    uint32_t overflows;
+    uint32_t counter;
+    do {
+        overflows = __tbase_overflows;
+        counter = btim_get_counter(__tbase_timer);
+        /* Overflow not processed yet (called with the timer IRQ masked). Read again to be sure the counter value is
+         * the wrapped one */
+        if (btim_is_update_pending(__tbase_timer)) {
+            counter = btim_get_counter(__tbase_timer);
+            overflows++;
+        }
+        /* The overflow ISR has run in between, values may be inconsistent */
+    } while (overflows != __tbase_overflows && overflows != __tbase_overflows + 1U);
+
+    return ((uint64_t)overflows << __TBASE_COUNTER_BITS) | (counter & __TBASE_COUNTER_MASK);
+}
+
+uint64_t tbase_extend_capture(uint16_t capture)
+{
+    /* The capture is assumed to be from the last 65.5 ms, the most recent time with these LSBs */
+    const uint64_t now = tbase_now_us();
+    uint64_t extended = (now & ~(uint64_t)__TBASE_COUNTER_MASK) | capture;
+    if (extended > now && extended >= (1U << __TBASE_COUNTER_BITS)) {
+        extended -= (1U << __TBASE_COUNTER_BITS);
+    }
+    return extended;
+}
+
+static void __tbase_overflow_handler(btim_instance_t *tim)
+{
+    (void)tim;
+    __tbase_overflows++;
+}
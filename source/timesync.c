@@ -0,0 +1,192 @@
+/* Copyright (C) Pablo Rodriguez Nava - All Rights Reserved
+ *       * Unauthorized copying of this file, via any medium is strictly prohibited
+ *       * Proprietary and confidential
+ * Written by Pablo Rodriguez Nava <info@pablintino.com>, January 2025
+ */
+
+#include "timesync.h"
+#include "analog_io_signals.h"
+
+#define __TSYNC_TYPE_SYNC 0x01U
+#define __TSYNC_TYPE_FOLLOW_UP 0x02U
+#define __TSYNC_SEQUENCE_MASK 0x0FU
+#define __TSYNC_MARKER_FLAG 0x80U
+
+/* Each new drift measurement contributes a quarter to the estimation */
+#define __TSYNC_DRIFT_FILTER_SHIFT 2U
+/* Way above any crystal tolerance. Anything bigger is a measurement glitch */
+#define __TSYNC_MAX_DRIFT_PPB 500000
+#define __TSYNC_PPB 1000000000LL
+
+#define __TSYNC_NEVER 0xFFFFFFFFFFFFFFFFULL
+
+static ret_status __tsync_send(tsync_state_t *state, uint8_t type, uint8_t sequence, uint64_t time, uint8_t marker);
+
+static void __tsync_update(tsync_state_t *state, uint64_t local, uint64_t master);
+
+ret_status tsync_init(tsync_state_t *state, const tsync_config_t *config, const tsync_link_t *link)
+{
+    if (state == NULL || config == NULL || link == NULL || link->send_frame == NULL) {
+        return STATUS_ERR;
+    }
+
+    if (config->role == TSYNC_ROLE_MASTER && config->sync_interval == 0) {
+        return STATUS_ERR;
+    }
+
+    state->config = *config;
+    state->link = link;
+    state->sequence = 0;
+    state->next_sync = 0;
+    state->sync_pending_tx = false;
+    state->follow_up_pending = false;
+    state->follow_up_time = 0;
+    state->sync_received = false;
+    state->sync_sequence = 0;
+    state->sync_local = 0;
+    /* The master is the time reference, so it is always synchronized */
+    state->synchronized = config->role == TSYNC_ROLE_MASTER;
+    state->has_reference = false;
+    state->reference_local = 0;
+    state->reference_global = 0;
+    state->drift_ppb = 0;
+    state->last_sync_local = 0;
+
+    return STATUS_OK;
+}
+
+uint64_t tsync_poll(tsync_state_t *state, uint64_t now)
+{
+    if (state->config.role == TSYNC_ROLE_SLAVE) {
+        /* Signed as the last RX timestamp may be slightly newer than a time sampled before processing the frame */
+        if (state->synchronized && (int64_t)(now - state->last_sync_local) > (int64_t)state->config.timeout) {
+            state->synchronized = false;
+        }
+        return state->synchronized ? state->last_sync_local + state->config.timeout + 1U : __TSYNC_NEVER;
+    }
+
+    if (state->follow_up_pending &&
+        __tsync_send(state, __TSYNC_TYPE_FOLLOW_UP, state->sequence, state->follow_up_time, 0) == STATUS_OK) {
+        state->follow_up_pending = false;
+    }
+
+    if (now >= state->next_sync) {
+        /* A SYNC whose TX timestamp never came back (lost or not sent) is just superseded by the new one. State is
+         * updated before sending as the TX timestamp may be reported before the link returns */
+        state->sequence = (state->sequence + 1U) & __TSYNC_SEQUENCE_MASK;
+        state->sync_pending_tx = true;
+        state->follow_up_pending = false;
+        if (__tsync_send(state, __TSYNC_TYPE_SYNC, state->sequence, 0, __TSYNC_MARKER_FLAG | state->sequence) ==
+            STATUS_OK) {
+            state->next_sync = now + state->config.sync_interval;
+        } else {
+            state->sync_pending_tx = false;
+        }
+    }
+
+    /* Link busy, retry as soon as possible */
+    return state->follow_up_pending || now >= state->next_sync ? now : state->next_sync;
+}
+
+ret_status tsync_on_frame(tsync_state_t *state, const uint8_t *data, uint8_t size, uint64_t rx_time)
+{
+    if (state == NULL || data == NULL || size < AIO_TIME_SYNC_SIZE) {
+        return STATUS_ERR;
+    }
+
+    /* Another master on the bus, just ignore it */
+    if (state->config.role == TSYNC_ROLE_MASTER) {
+        return STATUS_OK;
+    }
+
+    aio_time_sync_t frame;
+    aio_time_sync_unpack(&frame, data);
+
+    if (frame.type == __TSYNC_TYPE_SYNC) {
+        state->sync_received = true;
+        state->sync_sequence = frame.sequence;
+        state->sync_local = rx_time;
+        return STATUS_OK;
+    }
+
+    if (frame.type != __TSYNC_TYPE_FOLLOW_UP) {
+        return STATUS_ERR;
+    }
+
+    /* A FOLLOW_UP is only meaningful together with its own SYNC */
+    if (!state->sync_received || frame.sequence != state->sync_sequence) {
+        return STATUS_ERR;
+    }
+    state->sync_received = false;
+
+    __tsync_update(state, state->sync_local, frame.master_time);
+    return STATUS_OK;
+}
+
+void tsync_on_tx_timestamp(tsync_state_t *state, uint8_t marker, uint64_t tx_time)
+{
+    if (state->config.role != TSYNC_ROLE_MASTER || !state->sync_pending_tx ||
+        marker != (__TSYNC_MARKER_FLAG | state->sequence)) {
+        return;
+    }
+
+    state->sync_pending_tx = false;
+    state->follow_up_time = tx_time;
+    state->follow_up_pending =
+        __tsync_send(state, __TSYNC_TYPE_FOLLOW_UP, state->sequence, state->follow_up_time, 0) != STATUS_OK;
+}
+
+uint64_t tsync_to_global(const tsync_state_t *state, uint64_t local)
+{
+    if (state->config.role == TSYNC_ROLE_MASTER || !state->has_reference) {
+        return local;
+    }
+
+    const int64_t elapsed = (int64_t)(local - state->reference_local);
+    return state->reference_global + elapsed + (elapsed * state->drift_ppb) / __TSYNC_PPB;
+}
+
+bool tsync_is_synchronized(const tsync_state_t *state)
+{
+    return state->synchronized;
+}
+
+static ret_status __tsync_send(tsync_state_t *state, uint8_t type, uint8_t sequence, uint64_t time, uint8_t marker)
+{
+    aio_time_sync_t frame;
+    frame.sequence = sequence;
+    frame.type = type;
+    frame.master_time = time;
+
+    uint8_t data[AIO_TIME_SYNC_SIZE];
+    aio_time_sync_pack(data, &frame);
+    return state->link->send_frame(
+        state->link->context, state->config.id, state->config.extended_id, data, sizeof(data), marker);
+}
+
+static void __tsync_update(tsync_state_t *state, uint64_t local, uint64_t master)
+{
+    const int64_t error = (int64_t)(master - tsync_to_global(state, local));
+    const bool step = !state->has_reference || error > (int64_t)state->config.step_threshold ||
+                      error < -(int64_t)state->config.step_threshold;
+
+    const int64_t local_elapsed = (int64_t)(local - state->reference_local);
+    if (!step && local_elapsed > 0) {
+        /* Rate difference measured over the last sync interval, low pass filtered */
+        const int64_t master_elapsed = (int64_t)(master - state->reference_global);
+        int64_t measured_ppb = ((master_elapsed - local_elapsed) * __TSYNC_PPB) / local_elapsed;
+        if (measured_ppb > __TSYNC_MAX_DRIFT_PPB) {
+            measured_ppb = __TSYNC_MAX_DRIFT_PPB;
+        } else if (measured_ppb < -__TSYNC_MAX_DRIFT_PPB) {
+            measured_ppb = -__TSYNC_MAX_DRIFT_PPB;
+        }
+        state->drift_ppb += (int32_t)((measured_ppb - state->drift_ppb) / (1 << __TSYNC_DRIFT_FILTER_SHIFT));
+    }
+
+    /* Re-anchor on every sync. With the drift compensated the correction is just the residual error */
+    state->reference_local = local;
+    state->reference_global = master;
+    state->has_reference = true;
+    state->last_sync_local = local;
+    state->synchronized = true;
+}
@@ -0,0 +1,308 @@
+/* Copyright (C) Pablo Rodriguez Nava - All Rights Reserved
+ *       * Unauthorized copying of this file, via any medium is strictly prohibited
+ *       * Proprietary and confidential
+ * Written by Pablo Rodriguez Nava <info@pablintino.com>, January 2025
+ */
+
+/*
+ * Host test of the report-on-change logic. Checks deadband, alarm transitions, rate limiting and heartbeat through the
+ * arep API and runs the report task loop against a model of the ADC watchdogs: channel 0 guarded by a full resolution
+ * one (AWD1) and channel 1 by an 8-bit one (AWD2) with its thresholds rounded towards the inside of the window.
+ */
+
+#include "analog_report.h"
+
+#include <stdio.h>
+
+#define TEST_MIN_INTERVAL 5U
+#define TEST_HEARTBEAT_INTERVAL 1000U
+#define TEST_DEADBAND 0x0010U
+#define TEST_ALARM_LOW 0x0100U
+#define TEST_ALARM_HIGH 0x0F00U
+#define TEST_SIMULATION_TICKS 10000U
+
+#define TEST_CHECK(condition)                                                                                          \
+    do {                                                                                                               \
+        checks++;                                                                                                      \
+        if (!(condition)) {                                                                                            \
+            failures++;                                                                                                \
+            printf("FAILED: %s:%d: %s\n", __FILE__, __LINE__, #condition);                                             \
+        }                                                                                                              \
+    } while (0)
+
+typedef struct test_watchdog_t {
+    bool armed;
+    bool coarse;
+    uint16_t low;
+    uint16_t high;
+} test_watchdog_t;
+
+typedef struct test_run_t {
+    uint32_t reports;
+    uint32_t wake_ups;
+    uint32_t first_report_after_step;
+} test_run_t;
+
+static uint32_t checks;
+static uint32_t failures;
+
+static void test_init(arep_state_t *state)
+{
+    arep_config_t config = {0};
+    config.channel_count = 2;
+    config.min_interval = TEST_MIN_INTERVAL;
+    config.heartbeat_interval = TEST_HEARTBEAT_INTERVAL;
+    for (uint8_t index = 0; index < config.channel_count; index++) {
+        config.channels[index].alarm_low = TEST_ALARM_LOW;
+        config.channels[index].alarm_high = TEST_ALARM_HIGH;
+        config.channels[index].deadband = TEST_DEADBAND;
+    }
+    TEST_CHECK(arep_init(state, &config) == STATUS_OK);
+}
+
+static bool test_report(arep_state_t *state, uint16_t ch0, uint16_t ch1, uint32_t now, uint32_t *wait)
+{
+    const uint16_t samples[2] = {ch0, ch1};
+    if (!arep_evaluate(state, samples, now, wait)) {
+        return false;
+    }
+    arep_commit(state, samples, now);
+    return true;
+}
+
+static void test_config(void)
+{
+    arep_state_t state;
+    arep_config_t config = {0};
+
+    TEST_CHECK(arep_init(&state, &config) == STATUS_ERR);
+    config.channel_count = AREP_MAX_CHANNELS + 1U;
+    TEST_CHECK(arep_init(&state, &config) == STATUS_ERR);
+    config.channel_count = 1;
+    config.channels[0].alarm_low = 2;
+    config.channels[0].alarm_high = 1;
+    TEST_CHECK(arep_init(&state, &config) == STATUS_ERR);
+}
+
+static void test_deadband(void)
+{
+    arep_state_t state;
+    uint32_t wait;
+    uint16_t low;
+    uint16_t high;
+
+    test_init(&state);
+    TEST_CHECK(test_report(&state, 1000, 2000, 0, &wait));
+    TEST_CHECK(wait == TEST_HEARTBEAT_INTERVAL);
+
+    TEST_CHECK(arep_get_window(&state, 0, &low, &high) == STATUS_OK);
+    TEST_CHECK(low == 1000 - TEST_DEADBAND && high == 1000 + TEST_DEADBAND);
+    TEST_CHECK(arep_get_window(&state, 2, &low, &high) == STATUS_ERR);
+
+    /* Changes up to the deadband, in both directions, are not reported */
+    TEST_CHECK(!test_report(&state, 1000 + TEST_DEADBAND, 2000 - TEST_DEADBAND, 100, &wait));
+    TEST_CHECK(wait == TEST_HEARTBEAT_INTERVAL - 100);
+    TEST_CHECK(test_report(&state, 1000, 2000 - TEST_DEADBAND - 1, 101, &wait));
+    TEST_CHECK(test_report(&state, 1000 + TEST_DEADBAND + 1, 2000 - TEST_DEADBAND - 1, 200, &wait));
+}
+
+static void test_watchdog_events(void)
+{
+    arep_state_t state;
+    uint32_t wait;
+
+    test_init(&state);
+    TEST_CHECK(test_report(&state, 1000, 1553, 0, &wait));
+    TEST_CHECK(arep_rearm_watchdogs(&state, 0));
+    TEST_CHECK(!arep_rearm_watchdogs(&state, 0));
+
+    /* Event for a change inside the deadband: no report, watchdogs held disarmed for min_interval */
+    arep_notify_event(&state);
+    TEST_CHECK(!test_report(&state, 1000, 1551, 10, &wait));
+    TEST_CHECK(wait == TEST_MIN_INTERVAL);
+    TEST_CHECK(!arep_rearm_watchdogs(&state, 10));
+    TEST_CHECK(!arep_rearm_watchdogs(&state, 10 + TEST_MIN_INTERVAL - 1));
+    TEST_CHECK(!test_report(&state, 1000, 1551, 10 + TEST_MIN_INTERVAL, &wait));
+    TEST_CHECK(wait == TEST_HEARTBEAT_INTERVAL - 10 - TEST_MIN_INTERVAL);
+    TEST_CHECK(arep_rearm_watchdogs(&state, 10 + TEST_MIN_INTERVAL));
+
+    /* Event for a real change: reported and re-armed right away */
+    arep_notify_event(&state);
+    TEST_CHECK(test_report(&state, 1000, 1600, 20, &wait));
+    TEST_CHECK(arep_rearm_watchdogs(&state, 20));
+}
+
+static void test_alarms(void)
+{
+    arep_state_t state;
+    uint32_t wait;
+    uint16_t low;
+    uint16_t high;
+
+    test_init(&state);
+    TEST_CHECK(test_report(&state, TEST_ALARM_LOW + 2, TEST_ALARM_HIGH - 2, 0, &wait));
+    TEST_CHECK(arep_get_alarms(&state) == 0);
+
+    /* Window shrunk to the alarm limits, crossing them is reported even inside the deadband */
+    TEST_CHECK(arep_get_window(&state, 0, &low, &high) == STATUS_OK);
+    TEST_CHECK(low == TEST_ALARM_LOW && high == TEST_ALARM_LOW + 2 + TEST_DEADBAND);
+    TEST_CHECK(arep_get_window(&state, 1, &low, &high) == STATUS_OK);
+    TEST_CHECK(low == TEST_ALARM_HIGH - 2 - TEST_DEADBAND && high == TEST_ALARM_HIGH);
+
+    TEST_CHECK(test_report(&state, TEST_ALARM_LOW - 1, TEST_ALARM_HIGH - 2, 10, &wait));
+    TEST_CHECK(arep_get_alarms(&state) == 0x01U);
+    TEST_CHECK(arep_get_window(&state, 0, &low, &high) == STATUS_OK);
+    TEST_CHECK(low == TEST_ALARM_LOW - 1 - TEST_DEADBAND && high == TEST_ALARM_LOW - 1);
+
+    TEST_CHECK(test_report(&state, TEST_ALARM_LOW - 1, TEST_ALARM_HIGH + 1, 20, &wait));
+    TEST_CHECK(arep_get_alarms(&state) == 0x03U);
+    TEST_CHECK(arep_get_window(&state, 1, &low, &high) == STATUS_OK);
+    TEST_CHECK(low == TEST_ALARM_HIGH + 1 && high == TEST_ALARM_HIGH + 1 + TEST_DEADBAND);
+
+    /* Back to normal */
+    TEST_CHECK(test_report(&state, TEST_ALARM_LOW, TEST_ALARM_HIGH + 1, 30, &wait));
+    TEST_CHECK(arep_get_alarms(&state) == 0x02U);
+    TEST_CHECK(test_report(&state, TEST_ALARM_LOW, TEST_ALARM_HIGH, 40, &wait));
+    TEST_CHECK(arep_get_alarms(&state) == 0);
+}
+
+static void test_rate_limit(void)
+{
+    arep_state_t state;
+    uint32_t wait;
+
+    test_init(&state);
+    TEST_CHECK(test_report(&state, 1000, 2000, 0, &wait));
+    TEST_CHECK(!test_report(&state, 1100, 2000, 2, &wait));
+    TEST_CHECK(wait == TEST_MIN_INTERVAL - 2);
+    TEST_CHECK(!test_report(&state, 1100, 2000, TEST_MIN_INTERVAL - 1, &wait));
+    TEST_CHECK(wait == 1);
+    TEST_CHECK(test_report(&state, 1100, 2000, TEST_MIN_INTERVAL, &wait));
+
+    /* Alarm transitions are rate limited too */
+    TEST_CHECK(!test_report(&state, TEST_ALARM_LOW - 1, 2000, TEST_MIN_INTERVAL + 1, &wait));
+    TEST_CHECK(test_report(&state, TEST_ALARM_LOW - 1, 2000, 2 * TEST_MIN_INTERVAL, &wait));
+}
+
+static void test_heartbeat(void)
+{
+    arep_state_t state;
+    uint32_t wait;
+
+    test_init(&state);
+    TEST_CHECK(test_report(&state, 1000, 2000, 0, &wait));
+    TEST_CHECK(!test_report(&state, 1000, 2000, TEST_HEARTBEAT_INTERVAL - 1, &wait));
+    TEST_CHECK(wait == 1);
+    TEST_CHECK(test_report(&state, 1000, 2000, TEST_HEARTBEAT_INTERVAL, &wait));
+    TEST_CHECK(wait == TEST_HEARTBEAT_INTERVAL);
+
+    /* Tick counter wrap */
+    TEST_CHECK(test_report(&state, 1000, 2000, 0xFFFFFFF0U, &wait));
+    TEST_CHECK(!test_report(&state, 1000, 2000, 0x10U, &wait));
+    TEST_CHECK(wait == TEST_HEARTBEAT_INTERVAL - 0x20U);
+}
+
+static void test_program_watchdog(test_watchdog_t *watchdog, const arep_state_t *state, uint8_t channel)
+{
+    uint16_t low;
+    uint16_t high;
+    TEST_CHECK(arep_get_window(state, channel, &low, &high) == STATUS_OK);
+
+    watchdog->armed = true;
+    watchdog->low = low;
+    watchdog->high = high;
+    if (watchdog->coarse) {
+        /* Same rounding as the BSP applies to the 8 MSB comparison of AWD2/AWD3 for 12-bit conversions */
+        uint32_t reduced_high = ((uint32_t)high + 1U) >> 4U;
+        reduced_high = reduced_high > 0 ? reduced_high - 1U : 0;
+        uint32_t reduced_low = ((uint32_t)low + 15U) >> 4U;
+        reduced_low = reduced_low > 0xFFU ? 0xFFU : reduced_low;
+        watchdog->low = (uint16_t)(reduced_low << 4U);
+        watchdog->high = (uint16_t)((reduced_high << 4U) | 0x0FU);
+    }
+}
+
+static test_run_t test_run_task(uint16_t ch0, uint16_t ch1, uint16_t noise, uint32_t step_tick, uint16_t step)
+{
+    /* Mirrors AppTaskCanTX: woken up by the watchdogs or when the wait expires, one conversion per tick */
+    test_run_t run = {0};
+    arep_state_t state;
+    test_watchdog_t watchdogs[2] = {{false, false, 0, 0}, {false, true, 0, 0}};
+    uint32_t random = 12345;
+    uint32_t wait = 0;
+    uint32_t wake_tick = 0;
+
+    test_init(&state);
+    for (uint32_t now = 0; now < TEST_SIMULATION_TICKS; now++) {
+        uint16_t samples[2] = {ch0, ch1};
+        if (now >= step_tick) {
+            samples[1] += step;
+        }
+        for (uint8_t index = 0; index < 2U; index++) {
+            random = random * 1103515245U + 12345U;
+            samples[index] = (uint16_t)(samples[index] + ((random >> 16U) % (2U * noise + 1U)) - noise);
+        }
+
+        bool event = false;
+        for (uint8_t index = 0; index < 2U; index++) {
+            if (watchdogs[index].armed &&
+                (samples[index] < watchdogs[index].low || samples[index] > watchdogs[index].high)) {
+                watchdogs[0].armed = false;
+                watchdogs[1].armed = false;
+                event = true;
+            }
+        }
+        if (event) {
+            arep_notify_event(&state);
+        }
+        if (!event && (wait == AREP_WAIT_FOREVER || now - wake_tick < wait)) {
+            continue;
+        }
+
+        run.wake_ups++;
+        wake_tick = now;
+        if (arep_evaluate(&state, samples, now, &wait)) {
+            arep_commit(&state, samples, now);
+            run.reports++;
+            if (now >= step_tick && run.first_report_after_step == 0) {
+                run.first_report_after_step = now - step_tick + 1U;
+            }
+        }
+        if (arep_rearm_watchdogs(&state, now)) {
+            test_program_watchdog(&watchdogs[0], &state, 0);
+            test_program_watchdog(&watchdogs[1], &state, 1);
+        }
+    }
+    return run;
+}
+
+static void test_task_loop(void)
+{
+    /* Noise close to an 8-bit step boundary of the coarse watchdog: only heartbeats go out */
+    test_run_t run = test_run_task(1000, 1553, 2, TEST_SIMULATION_TICKS, 0);
+    TEST_CHECK(run.reports <= TEST_SIMULATION_TICKS / TEST_HEARTBEAT_INTERVAL + 1U);
+    TEST_CHECK(run.wake_ups <= TEST_SIMULATION_TICKS / TEST_MIN_INTERVAL + 1U);
+
+    /* Static inputs */
+    run = test_run_task(1000, 2000, 0, TEST_SIMULATION_TICKS, 0);
+    TEST_CHECK(run.reports == TEST_SIMULATION_TICKS / TEST_HEARTBEAT_INTERVAL);
+
+    /* Real changes are still reported right away, even while the watchdogs are held disarmed */
+    run = test_run_task(1000, 1553, 2, 5000, 3 * TEST_DEADBAND);
+    TEST_CHECK(run.first_report_after_step != 0 && run.first_report_after_step <= TEST_MIN_INTERVAL);
+    TEST_CHECK(run.reports <= TEST_SIMULATION_TICKS / TEST_HEARTBEAT_INTERVAL + 2U);
+}
+
+int main(void)
+{
+    test_config();
+    test_deadband();
+    test_watchdog_events();
+    test_alarms();
+    test_rate_limit();
+    test_heartbeat();
+    test_task_loop();
+
+    printf("%u/%u checks passed\n", checks - failures, checks);
+    return failures == 0 ? 0 : 1;
+}
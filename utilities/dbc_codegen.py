@@ -0,0 +1,429 @@
+#!/usr/bin/env python3
+# Copyright (C) Pablo Rodriguez Nava - All Rights Reserved
+#       * Unauthorized copying of this file, via any medium is strictly prohibited
+#       * Proprietary and confidential
+# Written by Pablo Rodriguez Nava <info@pablintino.com>, January 2025
+
+"""
+Generates C pack/unpack functions from a DBC file.
+
+Every frame gets a struct with the raw value of its signals and two static inline functions that move the signals
+from/to the frame bytes with constant shifts and masks. Nothing is interpreted at runtime, so the same header is used
+by the firmware and by the host side decoder, also generated here, that converts raw values to physical ones.
+
+Only the subset of the DBC syntax needed to describe frames is understood (BO_ and SG_ entries). Multiplexed signals
+are not supported.
+
+Outputs, for --name NAME:
+    NAME_signals.h: pack/unpack functions. Header only, no dependencies beyond stdint/stdbool.
+    NAME_decoder.h/.c: host decoder. Converts a frame to a list of named physical values.
+"""
+
+import argparse
+import os
+import re
+import sys
+
+CAN_FD_SIZES = (0, 1, 2, 3, 4, 5, 6, 7, 8, 12, 16, 20, 24, 32, 48, 64)
+EXTENDED_ID_FLAG = 0x80000000
+MAX_LINE_LENGTH = 120
+
+MESSAGE_RE = re.compile(r'^BO_\s+(\d+)\s+(\w+)\s*:\s*(\d+)\s+(\w+)')
+SIGNAL_RE = re.compile(
+    r'^SG_\s+(\w+)\s*(\S*)\s*:\s*(\d+)\|(\d+)@([01])([+-])\s*'
+    r'\(\s*([^,]+)\s*,\s*([^)]+)\)\s*\[\s*([^|]+)\|([^\]]+)\]\s*"([^"]*)"')
+
+
+class Signal:
+
+    def __init__(self, name, start, length, little_endian, signed, scale, offset, minimum, maximum, unit):
+        self.name = name
+        self.start = start
+        self.length = length
+        self.little_endian = little_endian
+        self.signed = signed
+        self.scale = scale
+        self.offset = offset
+        self.minimum = minimum
+        self.maximum = maximum
+        self.unit = unit
+
+    @property
+    def field(self):
+        return self.name.lower()
+
+    @property
+    def width(self):
+        return next(width for width in (8, 16, 32, 64) if self.length <= width)
+
+    @property
+    def c_type(self):
+        return '{}int{}_t'.format('' if self.signed else 'u', self.width)
+
+    @property
+    def c_unsigned_type(self):
+        return 'uint{}_t'.format(self.width)
+
+    def bit_positions(self):
+        """Frame bit position (byte * 8 + bit, LSB first) of every raw bit, from LSB to MSB"""
+        if self.little_endian:
+            return [self.start + index for index in range(self.length)]
+
+        # Motorola: the start bit is the MSB and the signal moves to the next byte when reaching bit 0
+        positions = []
+        position = self.start
+        for _ in range(self.length):
+            positions.append(position)
+            position = position + 15 if position % 8 == 0 else position - 1
+        positions.reverse()
+        return positions
+
+    def chunks(self):
+        """Splits the signal in (byte, bit in byte, raw bit, width) runs of contiguous bits"""
+        chunks = []
+        for raw_bit, position in enumerate(self.bit_positions()):
+            byte, bit = divmod(position, 8)
+            if chunks:
+                last_byte, last_bit, last_raw_bit, last_width = chunks[-1]
+                if last_byte == byte and last_bit + last_width == bit:
+                    chunks[-1] = (last_byte, last_bit, last_raw_bit, last_width + 1)
+                    continue
+            chunks.append((byte, bit, raw_bit, 1))
+        return chunks
+
+
+class Message:
+
+    def __init__(self, frame_id, name, size):
+        self.extended_id = bool(frame_id & EXTENDED_ID_FLAG)
+        self.id = frame_id & ~EXTENDED_ID_FLAG
+        self.name = name
+        self.size = size
+        self.signals = []
+
+    @property
+    def c_name(self):
+        return self.name.lower()
+
+
+def _error(path, line_number, message):
+    sys.exit('{}:{}: error: {}'.format(path, line_number, message))
+
+
+def parse_dbc(path):
+    messages = []
+    with open(path, encoding='utf-8', errors='replace') as dbc_file:
+        for line_number, line in enumerate(dbc_file, 1):
+            line = line.strip()
+            if line.startswith('BO_ '):
+                match = MESSAGE_RE.match(line)
+                if match is None:
+                    _error(path, line_number, 'malformed message')
+                message = Message(int(match.group(1)), match.group(2), int(match.group(3)))
+                if message.size not in CAN_FD_SIZES:
+                    _error(path, line_number, '{} bytes is not a valid CAN/CAN FD frame size'.format(message.size))
+                messages.append(message)
+            elif line.startswith('SG_ '):
+                match = SIGNAL_RE.match(line)
+                if match is None or not messages:
+                    _error(path, line_number, 'malformed signal or signal outside a message')
+                if match.group(2):
+                    _error(path, line_number, 'multiplexed signals are not supported')
+                signal = Signal(match.group(1),
+                                int(match.group(3)),
+                                int(match.group(4)),
+                                match.group(5) == '1',
+                                match.group(6) == '-',
+                                float(match.group(7)),
+                                float(match.group(8)),
+                                float(match.group(9)),
+                                float(match.group(10)),
+                                match.group(11))
+                _validate_signal(path, line_number, messages[-1], signal)
+                messages[-1].signals.append(signal)
+    return messages
+
+
+def _validate_signal(path, line_number, message, signal):
+    if not 1 <= signal.length <= 64:
+        _error(path, line_number, '{}: length must be between 1 and 64 bits'.format(signal.name))
+    positions = signal.bit_positions()
+    if min(positions) < 0 or max(positions) >= message.size * 8:
+        _error(path, line_number, '{}: outside the {} bytes of {}'.format(signal.name, message.size, message.name))
+    used = set()
+    for other in message.signals:
+        if other.field == signal.field:
+            _error(path, line_number, '{}: duplicated signal'.format(signal.name))
+        used.update(other.bit_positions())
+    if used.intersection(positions):
+        _error(path, line_number, '{}: overlaps another signal of {}'.format(signal.name, message.name))
+
+
+def _hex(value):
+    return '0x{:02X}U'.format(value)
+
+
+def _mask(width):
+    return (1 << width) - 1
+
+
+def _pack_expression(signal, bit, raw_bit, width):
+    value = 'message->{}'.format(signal.field)
+    if signal.signed:
+        value = '(({}){})'.format(signal.c_unsigned_type, value)
+    if raw_bit != 0:
+        value = '({} >> {}U)'.format(value, raw_bit)
+    value = '({} & {})'.format(value, _hex(_mask(width)))
+    if bit != 0:
+        value = '({} << {}U)'.format(value, bit)
+    return value
+
+
+def _wrap(start, terms, end):
+    line = start + ' | '.join(terms) + end
+    if len(line) <= MAX_LINE_LENGTH:
+        return line
+    return start + ' |\n{}'.format(' ' * len(start)).join(terms) + end
+
+
+def _unpack_statement(signal):
+    raw_type = 'uint64_t' if signal.length > 32 else 'uint32_t'
+    terms = []
+    for byte, bit, raw_bit, width in signal.chunks():
+        term = 'data[{}]'.format(byte)
+        if bit != 0:
+            term = '({} >> {}U)'.format(term, bit)
+        if bit + width != 8:
+            term = '({} & {})'.format(term, _hex(_mask(width)))
+        term = '({}){}'.format(raw_type, term)
+        if raw_bit != 0:
+            term = '({} << {}U)'.format(term, raw_bit)
+        terms.append(term)
+
+    start = '    message->{} = ({})('.format(signal.field, signal.c_type)
+    if signal.signed and signal.length != signal.width:
+        # Sign extension without relying on arithmetic right shifts
+        sign = '0x{:X}U'.format(1 << (signal.length - 1)) + ('LL' if signal.length > 32 else '')
+        return _wrap(start + '((', terms, ') ^ {}) - {});'.format(sign, sign))
+    return _wrap(start, terms, ');')
+
+
+def _c_double(value):
+    text = repr(float(value))
+    return text if ('.' in text or 'e' in text or 'inf' in text) else text + '.0'
+
+
+def _c_string(value):
+    return '"{}"'.format(value.replace('\\', '\\\\').replace('"', '\\"'))
+
+
+def _file_header(dbc_name):
+    return ('/* Generated by dbc_codegen.py from {}. Do not edit, changes are lost on the next build */\n'
+            .format(dbc_name))
+
+
+def generate_signals_header(messages, name, prefix, dbc_name):
+    guard = '{}_SIGNALS_H'.format(name.upper())
+    upper_prefix = prefix.upper()
+    lines = [_file_header(dbc_name),
+             '/**',
+             ' * @file {}_signals.h'.format(name),
+             ' * @brief Pack/unpack functions of the frames described in {}.'.format(dbc_name),
+             ' *',
+             ' * Struct fields hold raw signal values (scale and offset not applied). Pack writes every byte of the frame,',
+             ' * unused bits are set to zero.',
+             ' */',
+             '#ifndef {}'.format(guard),
+             '#define {}'.format(guard),
+             '',
+             '#include <stdbool.h>',
+             '#include <stdint.h>',
+             '']
+
+    for message in messages:
+        macro = '{}_{}'.format(upper_prefix, message.name.upper())
+        type_name = '{}_{}_t'.format(prefix, message.c_name)
+        function = '{}_{}'.format(prefix, message.c_name)
+        lines += ['/* {} */'.format(message.name),
+                  '#define {}_ID 0x{:08X}U'.format(macro, message.id),
+                  '#define {}_EXTENDED_ID {}'.format(macro, 'true' if message.extended_id else 'false'),
+                  '#define {}_SIZE {}U'.format(macro, message.size),
+                  '',
+                  'typedef struct {} {{'.format(type_name)]
+        lines += ['    {} {};'.format(signal.c_type, signal.field) for signal in message.signals]
+        if not message.signals:
+            lines.append('    uint8_t unused;')
+        lines += ['}} {};'.format(type_name), '']
+
+        byte_terms = [[] for _ in range(message.size)]
+        for signal in message.signals:
+            for byte, bit, raw_bit, width in signal.chunks():
+                byte_terms[byte].append(_pack_expression(signal, bit, raw_bit, width))
+
+        lines += ['static inline void {}_pack(uint8_t *data, const {} *message)'.format(function, type_name), '{']
+        if not message.signals:
+            lines.append('    (void)message;')
+        for byte, terms in enumerate(byte_terms):
+            if not terms:
+                lines.append('    data[{}] = 0x00U;'.format(byte))
+            elif len(terms) == 1:
+                lines.append('    data[{}] = (uint8_t){};'.format(byte, terms[0]))
+            else:
+                lines.append(_wrap('    data[{}] = (uint8_t)('.format(byte), terms, ');'))
+        lines += ['}', '']
+
+        lines += ['static inline void {}_unpack({} *message, const uint8_t *data)'.format(function, type_name), '{']
+        if not message.signals:
+            lines += ['    (void)data;', '    message->unused = 0;']
+        for signal in message.signals:
+            lines.append(_unpack_statement(signal))
+        lines += ['}', '']
+
+    lines += ['#endif // {}'.format(guard), '']
+    return '\n'.join(lines)
+
+
+def generate_decoder_header(messages, name, prefix, dbc_name):
+    guard = '{}_DECODER_H'.format(name.upper())
+    upper_prefix = prefix.upper()
+    max_signals = max([len(message.signals) for message in messages] + [1])
+    return '\n'.join([
+        _file_header(dbc_name),
+        '/**',
+        ' * @file {}_decoder.h'.format(name),
+        ' * @brief Host side decoder of the frames described in {}.'.format(dbc_name),
+        ' *',
+        ' * Converts a received frame to the physical values (scale and offset applied) of its signals.',
+        ' */',
+        '#ifndef {}'.format(guard),
+        '#define {}'.format(guard),
+        '',
+        '#include "{}_signals.h"'.format(name),
+        '',
+        '#define {}_MAX_SIGNALS {}U'.format(upper_prefix, max_signals),
+        '',
+        'typedef struct {}_signal_value_t {{'.format(prefix),
+        '    const char *name;',
+        '    const char *unit;',
+        '    double value;',
+        '}} {}_signal_value_t;'.format(prefix),
+        '',
+        'typedef struct {}_message_info_t {{'.format(prefix),
+        '    uint32_t id;',
+        '    bool extended_id;',
+        '    uint8_t size;',
+        '    const char *name;',
+        '    uint8_t signal_count;',
+        '    void (*decode)(const uint8_t *data, {}_signal_value_t *values);'.format(prefix),
+        '}} {}_message_info_t;'.format(prefix),
+        '',
+        'const {0}_message_info_t *{0}_find_message(uint32_t id, bool extended_id);'.format(prefix),
+        '',
+        '/**',
+        ' * Decodes a frame into values, that must have room for {}_MAX_SIGNALS entries.'.format(upper_prefix),
+        ' * Returns the number of decoded signals or -1 if the frame is unknown or shorter than expected.',
+        ' */',
+        'int {0}_decode(uint32_t id, bool extended_id, const uint8_t *data, uint8_t size, {0}_signal_value_t *values);'
+        .format(prefix),
+        '',
+        '#endif // {}'.format(guard),
+        ''])
+
+
+def generate_decoder_source(messages, name, prefix, dbc_name):
+    lines = [_file_header(dbc_name),
+             '#include "{}_decoder.h"'.format(name),
+             '',
+             '#include <stddef.h>',
+             '']
+
+    for message in messages:
+        function = '{}_{}'.format(prefix, message.c_name)
+        lines += ['static void __{}_decode_{}(const uint8_t *data, {}_signal_value_t *values)'.format(
+            prefix, message.c_name, prefix), '{']
+        if message.signals:
+            lines += ['    {}_t message;'.format(function), '    {}_unpack(&message, data);'.format(function)]
+        else:
+            lines += ['    (void)data;', '    (void)values;']
+        for index, signal in enumerate(message.signals):
+            value = '(double)message.{}'.format(signal.field)
+            if signal.scale != 1.0:
+                value = '{} * {}'.format(value, _c_double(signal.scale))
+            if signal.offset != 0.0:
+                value = '{} + {}'.format(value, _c_double(signal.offset))
+            lines += ['    values[{}].name = {};'.format(index, _c_string(signal.name)),
+                      '    values[{}].unit = {};'.format(index, _c_string(signal.unit)),
+                      '    values[{}].value = {};'.format(index, value)]
+        lines += ['}', '']
+
+    lines.append('static const {}_message_info_t __{}_messages[] = {{'.format(prefix, prefix))
+    for message in messages:
+        lines.append('    {{0x{:08X}U, {}, {}U, {}, {}U, __{}_decode_{}}},'.format(
+            message.id, 'true' if message.extended_id else 'false', message.size, _c_string(message.name),
+            len(message.signals), prefix, message.c_name))
+    lines += ['};', '']
+
+    lines += ['const {0}_message_info_t *{0}_find_message(uint32_t id, bool extended_id)'.format(prefix),
+              '{',
+              '    for (uint32_t index = 0; index < sizeof(__{0}_messages) / sizeof(__{0}_messages[0]); index++) {{'
+              .format(prefix),
+              '        if (__{0}_messages[index].id == id && __{0}_messages[index].extended_id == extended_id) {{'
+              .format(prefix),
+              '            return &__{}_messages[index];'.format(prefix),
+              '        }',
+              '    }',
+              '    return NULL;',
+              '}',
+              '',
+              'int {0}_decode(uint32_t id, bool extended_id, const uint8_t *data, uint8_t size, {0}_signal_value_t '
+              '*values)'.format(prefix),
+              '{',
+              '    const {0}_message_info_t *message = {0}_find_message(id, extended_id);'.format(prefix),
+              '    if (message == NULL || data == NULL || values == NULL || size < message->size) {',
+              '        return -1;',
+              '    }',
+              '',
+              '    message->decode(data, values);',
+              '    return message->signal_count;',
+              '}',
+              '']
+    return '\n'.join(lines)
+
+
+def _write_if_changed(path, content):
+    # Keeps timestamps untouched when nothing changes to avoid needless rebuilds
+    if os.path.exists(path):
+        with open(path, encoding='utf-8') as current_file:
+            if current_file.read() == content:
+                return
+    with open(path, 'w', encoding='utf-8') as output_file:
+        output_file.write(content)
+
+
+def main():
+    parser = argparse.ArgumentParser(description='Generates C pack/unpack functions and a decoder from a DBC file')
+    parser.add_argument('dbc', help='DBC file')
+    parser.add_argument('--name', required=True, help='Base name of the generated files')
+    parser.add_argument('--prefix', required=True, help='Prefix of the generated C symbols')
+    parser.add_argument('--output-dir', required=True, help='Directory where the files are generated')
+    args = parser.parse_args()
+
+    if not re.match(r'^[a-z_][a-z0-9_]*$', args.prefix) or not re.match(r'^[a-z_][a-z0-9_]*$', args.name):
+        sys.exit('error: name and prefix must be lower case C identifiers')
+
+    messages = parse_dbc(args.dbc)
+    if not messages:
+        sys.exit('error: no messages found in {}'.format(args.dbc))
+
+    dbc_name = os.path.basename(args.dbc)
+    os.makedirs(args.output_dir, exist_ok=True)
+    _write_if_changed(os.path.join(args.output_dir, '{}_signals.h'.format(args.name)),
+                      generate_signals_header(messages, args.name, args.prefix, dbc_name))
+    _write_if_changed(os.path.join(args.output_dir, '{}_decoder.h'.format(args.name)),
+                      generate_decoder_header(messages, args.name, args.prefix, dbc_name))
+    _write_if_changed(os.path.join(args.output_dir, '{}_decoder.c'.format(args.name)),
+                      generate_decoder_source(messages, args.name, args.prefix, dbc_name))
+
+
+if __name__ == '__main__':
+    main()
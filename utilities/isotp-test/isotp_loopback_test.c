@@ -0,0 +1,208 @@
+/* Copyright (C) Pablo Rodriguez Nava - All Rights Reserved
+ *       * Unauthorized copying of this file, via any medium is strictly prohibited
+ *       * Proprietary and confidential
+ * Written by Pablo Rodriguez Nava <info@pablintino.com>, January 2025
+ */
+
+/*
+ * Host test of the ISO-TP transport. Two channels are connected through a looped-back bus and exchange messages in
+ * both directions at the same time, for every combination of frame size, block size, STmin and busy link. The bus
+ * delivers the frames sent in a tick during the next one. Checks received data, results and STmin separation.
+ */
+
+#include "isotp.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#define TEST_ID_A 0x77200U
+#define TEST_ID_B 0x77201U
+#define TEST_BUS_CAPACITY 256U
+#define TEST_MAX_MESSAGE_SIZE 5000U
+#define TEST_MAX_TICKS 100000U
+
+typedef struct test_frame_t {
+    uint32_t id;
+    uint8_t data[ISOTP_MAX_FRAME_SIZE];
+    uint8_t size;
+} test_frame_t;
+
+typedef struct test_peer_t {
+    isotp_channel_t channel;
+    uint8_t tx_data[TEST_MAX_MESSAGE_SIZE];
+    uint8_t rx_data[TEST_MAX_MESSAGE_SIZE];
+    uint32_t rx_size;
+    bool tx_done;
+    bool rx_done;
+    isotp_result_t tx_result;
+    isotp_result_t rx_result;
+    /* Tick of the last CF sent since the last received flow control */
+    bool last_cf_valid;
+    uint32_t last_cf_tick;
+} test_peer_t;
+
+static test_frame_t bus[TEST_BUS_CAPACITY];
+static uint32_t bus_count;
+static uint32_t now;
+static bool busy_link;
+static uint32_t send_calls;
+static uint32_t peer_st_min_ticks;
+static uint32_t st_min_violations;
+static test_peer_t peers[2];
+
+static ret_status test_send_frame(void *context, uint32_t id, bool extended_id, const uint8_t *data, uint8_t size)
+{
+    test_peer_t *peer = (test_peer_t *)context;
+    (void)extended_id;
+
+    /* Busy link rejects one of every three frames */
+    if ((busy_link && (++send_calls % 3U) == 0U) || bus_count >= TEST_BUS_CAPACITY) {
+        return STATUS_ERR;
+    }
+
+    if ((data[0] & 0xF0U) == 0x20U) {
+        if (peer_st_min_ticks != 0 && peer->last_cf_valid && (now - peer->last_cf_tick) <= peer_st_min_ticks) {
+            st_min_violations++;
+        }
+        peer->last_cf_valid = true;
+        peer->last_cf_tick = now;
+    }
+
+    bus[bus_count].id = id;
+    bus[bus_count].size = size;
+    memcpy(bus[bus_count].data, data, size);
+    bus_count++;
+    return STATUS_OK;
+}
+
+static const isotp_link_t link_a = {test_send_frame, &peers[0]};
+static const isotp_link_t link_b = {test_send_frame, &peers[1]};
+
+static void test_tx_handler(isotp_channel_t *channel, isotp_result_t result)
+{
+    test_peer_t *peer = (test_peer_t *)channel->user_data;
+    peer->tx_done = true;
+    peer->tx_result = result;
+}
+
+static void test_rx_handler(isotp_channel_t *channel, isotp_result_t result, uint8_t *data, uint32_t size)
+{
+    test_peer_t *peer = (test_peer_t *)channel->user_data;
+    (void)data;
+    peer->rx_done = true;
+    peer->rx_result = result;
+    peer->rx_size = size;
+}
+
+static void test_deliver_frames(void)
+{
+    /* Frames sent while delivering go out in the next tick */
+    test_frame_t pending[TEST_BUS_CAPACITY];
+    const uint32_t pending_count = bus_count;
+    memcpy(pending, bus, sizeof(test_frame_t) * pending_count);
+    bus_count = 0;
+
+    for (uint32_t index = 0; index < pending_count; index++) {
+        test_peer_t *receiver = pending[index].id == TEST_ID_A ? &peers[1] : &peers[0];
+        if ((pending[index].data[0] & 0xF0U) == 0x30U) {
+            receiver->last_cf_valid = false;
+        }
+        isotp_on_frame(&receiver->channel, pending[index].data, pending[index].size, now);
+    }
+}
+
+static bool test_transfer(uint8_t frame_size, uint8_t block_size, uint8_t st_min, bool busy, uint32_t size)
+{
+    isotp_channel_config_t config = {0};
+    config.extended_id = true;
+    config.frame_size = frame_size;
+    config.block_size = block_size;
+    config.st_min = st_min;
+    config.timeout = 1000U;
+    config.padding = 0xCCU;
+    config.tx_handler = test_tx_handler;
+    config.rx_handler = test_rx_handler;
+
+    memset(peers, 0, sizeof(peers));
+    bus_count = 0;
+    busy_link = busy;
+    send_calls = 0;
+    st_min_violations = 0;
+    /* Both peers advertise the same STmin, rounded up to a tick for the sub-millisecond values */
+    peer_st_min_ticks = st_min <= 0x7FU ? st_min : 1U;
+
+    config.tx_id = TEST_ID_A;
+    config.rx_id = TEST_ID_B;
+    isotp_init(&peers[0].channel, &config, &link_a);
+    config.tx_id = TEST_ID_B;
+    config.rx_id = TEST_ID_A;
+    isotp_init(&peers[1].channel, &config, &link_b);
+
+    for (uint8_t index = 0; index < 2U; index++) {
+        peers[index].channel.user_data = &peers[index];
+        isotp_set_rx_buffer(&peers[index].channel, peers[index].rx_data, sizeof(peers[index].rx_data));
+        for (uint32_t byte = 0; byte < size; byte++) {
+            peers[index].tx_data[byte] = (uint8_t)(byte * 7U + index * 31U + size);
+        }
+    }
+
+    now = 0;
+    isotp_send(&peers[0].channel, peers[0].tx_data, size, now);
+    isotp_send(&peers[1].channel, peers[1].tx_data, size, now);
+    while (!(peers[0].tx_done && peers[0].rx_done && peers[1].tx_done && peers[1].rx_done) && now < TEST_MAX_TICKS) {
+        now++;
+        test_deliver_frames();
+        isotp_poll(&peers[0].channel, now);
+        isotp_poll(&peers[1].channel, now);
+    }
+
+    bool passed = st_min_violations == 0;
+    for (uint8_t index = 0; index < 2U; index++) {
+        const test_peer_t *peer = &peers[index];
+        const test_peer_t *sender = &peers[1U - index];
+        passed = passed && peer->tx_done && peer->rx_done && peer->tx_result == ISOTP_RESULT_OK &&
+                 peer->rx_result == ISOTP_RESULT_OK && peer->rx_size == size &&
+                 memcmp(peer->rx_data, sender->tx_data, size) == 0;
+    }
+
+    if (!passed) {
+        printf("FAILED: frame size %u, BS %u, STmin 0x%02X, busy %u, size %u (ticks %u, STmin violations %u)\n",
+               frame_size,
+               block_size,
+               st_min,
+               busy,
+               size,
+               now,
+               st_min_violations);
+    }
+    return passed;
+}
+
+int main(void)
+{
+    static const uint8_t frame_sizes[] = {ISOTP_CLASSIC_FRAME_SIZE, 12U, ISOTP_MAX_FRAME_SIZE};
+    static const uint8_t block_sizes[] = {0U, 1U, 3U};
+    static const uint8_t st_mins[] = {0x00U, 0x01U, 0x03U, 0xF3U};
+    static const uint32_t sizes[] = {1U, 7U, 8U, 11U, 62U, 63U, 100U, 300U, 4095U, TEST_MAX_MESSAGE_SIZE};
+
+    uint32_t total = 0;
+    uint32_t failed = 0;
+    for (uint32_t frame = 0; frame < sizeof(frame_sizes); frame++) {
+        for (uint32_t block = 0; block < sizeof(block_sizes); block++) {
+            for (uint32_t st_min = 0; st_min < sizeof(st_mins); st_min++) {
+                for (uint32_t size = 0; size < sizeof(sizes) / sizeof(sizes[0]); size++) {
+                    for (uint8_t busy = 0; busy < 2U; busy++) {
+                        total++;
+                        if (!test_transfer(
+                                frame_sizes[frame], block_sizes[block], st_mins[st_min], busy != 0U, sizes[size])) {
+                            failed++;
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    printf("%u/%u transfers passed\n", total - failed, total);
+    return failed == 0 ? 0 : 1;
+}